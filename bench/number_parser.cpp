@@ -0,0 +1,207 @@
+/**
+ * number_parser:
+ * Micro-benchmark of the NumberParser against strtod/strtof/strtol on the
+ * numbers in a real .obj file. Every value is also checked against strtof,
+ * so this doubles as a test of the rounding.
+ *
+ * Usage: bench/number_parser [file.obj] [repetitions]
+ */
+
+#include "generic/MappedFile.hpp"
+#include "generic/NumberParser.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+using namespace cs354;
+
+static const char _default_file[] = "./data/model/blueshell.obj";
+
+/* One number token, null terminated so the C library can read it too */
+struct Token {
+    const char *begin, *end;
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/* Splits every v/vn/vt/f line into number tokens. Faces keep whole a/b/c
+ * tuples so NumberParser::Face can be timed as well. */
+static void collect(const MappedFile &file, std::string &text,
+                    std::vector<Token> &floats, std::vector<Token> &faces)
+{
+    /* Copy everything into one buffer with a null after every token */
+    std::vector<std::pair<size_t, size_t> > fspans, tspans;
+    const char *p = file.data(), *end = file.end();
+    while(p < end) {
+        const char *eol = static_cast<const char *>(
+            memchr(p, '\n', end - p));
+        if(eol == NULL) {
+            eol = end;
+        }
+        bool is_face = (p[0] == 'f' && p + 1 < eol && p[1] == ' ');
+        bool is_vert = (p[0] == 'v');
+        if(is_face || is_vert) {
+            const char *q = p;
+            while(q < eol && *q != ' ') {
+                q++;
+            }
+            while(q < eol) {
+                while(q < eol && (*q == ' ' || *q == '\t' || *q == '\r')) {
+                    q++;
+                }
+                const char *start = q;
+                while(q < eol && *q != ' ' && *q != '\t' && *q != '\r') {
+                    q++;
+                }
+                if(q > start) {
+                    size_t off = text.size();
+                    text.append(start, q);
+                    text.push_back('\0');
+                    std::pair<size_t, size_t> span(off, q - start);
+                    (is_face ? tspans : fspans).push_back(span);
+                }
+            }
+        }
+        p = eol + 1;
+    }
+    
+    const char *base = text.data();
+    for(size_t i = 0; i < fspans.size(); ++i) {
+        Token t = { base + fspans[i].first,
+                    base + fspans[i].first + fspans[i].second };
+        floats.push_back(t);
+    }
+    for(size_t i = 0; i < tspans.size(); ++i) {
+        Token t = { base + tspans[i].first,
+                    base + tspans[i].first + tspans[i].second };
+        faces.push_back(t);
+    }
+}
+
+enum Method {
+    STRTOD,
+    STRTOF,
+    PARSER_FLOAT,
+    STRTOL_FACE,
+    PARSER_FACE
+};
+/* Returns the best time of 'reps' runs, keeping a checksum so nothing is
+ * optimized away. */
+static double run(Method method, const std::vector<Token> &tokens, int reps,
+                  double &checksum)
+{
+    double best = 1e30;
+    for(int r = 0; r < reps; ++r) {
+        double sum = 0.0;
+        double start = now();
+        for(size_t i = 0; i < tokens.size(); ++i) {
+            const Token &t = tokens[i];
+            float f;
+            int args[3];
+            char *next;
+            switch(method) {
+            case STRTOD:
+                sum += float(strtod(t.begin, NULL));
+                break;
+            case STRTOF:
+                sum += strtof(t.begin, NULL);
+                break;
+            case PARSER_FLOAT:
+                NumberParser::Float(t.begin, t.end, f);
+                sum += f;
+                break;
+            case STRTOL_FACE:
+                args[0] = args[1] = args[2] = 0;
+                args[0] = int(strtol(t.begin, &next, 10));
+                for(int k = 1; k < 3 && *next == '/'; ++k) {
+                    next++;
+                    if(*next != '/') {
+                        args[k] = int(strtol(next, &next, 10));
+                    }
+                }
+                sum += args[0] + args[1] + args[2];
+                break;
+            case PARSER_FACE:
+                NumberParser::Face(t.begin, t.end, args);
+                sum += args[0] + args[1] + args[2];
+                break;
+            }
+        }
+        double elapsed = now() - start;
+        best = (elapsed < best ? elapsed : best);
+        checksum = sum;
+    }
+    return best;
+}
+
+static void report(const char *name, double secs, size_t count,
+                   size_t bytes)
+{
+    printf("  %-22s %8.2f ms %8.2f ns/number %8.1f MB/s\n", name,
+           secs * 1e3, secs * 1e9 / (count ? count : 1),
+           bytes / (secs * 1024.0 * 1024.0));
+}
+
+int main(int argc, char **argv) {
+    const char *fname = (argc > 1 ? argv[1] : _default_file);
+    int reps = (argc > 2 ? atoi(argv[2]) : 5);
+    if(reps < 1) {
+        reps = 1;
+    }
+    
+    MappedFile file;
+    if(!file.open(fname)) {
+        fprintf(stderr, "Could not open %s\n", fname);
+        return 1;
+    }
+    std::string text;
+    std::vector<Token> floats, faces;
+    collect(file, text, floats, faces);
+    
+    size_t float_bytes = 0, face_bytes = 0;
+    for(size_t i = 0; i < floats.size(); ++i) {
+        float_bytes += floats[i].end - floats[i].begin;
+    }
+    for(size_t i = 0; i < faces.size(); ++i) {
+        face_bytes += faces[i].end - faces[i].begin;
+    }
+    
+    /* Everything has to agree with strtof before timings mean anything */
+    size_t mismatches = 0;
+    for(size_t i = 0; i < floats.size(); ++i) {
+        float expect = strtof(floats[i].begin, NULL), got;
+        const char *stop = NumberParser::Float(floats[i].begin, floats[i].end,
+                                               got);
+        if(stop != floats[i].end || memcmp(&expect, &got, sizeof(got)) != 0) {
+            if(mismatches++ < 10) {
+                fprintf(stderr, "Mismatch on '%s': %.9g, expected %.9g\n",
+                        floats[i].begin, got, expect);
+            }
+        }
+    }
+    
+    printf("%s: %lu floats, %lu face tuples, best of %d\n", fname,
+           (unsigned long)floats.size(), (unsigned long)faces.size(), reps);
+    double check;
+    report("strtod", run(STRTOD, floats, reps, check), floats.size(),
+           float_bytes);
+    report("strtof", run(STRTOF, floats, reps, check), floats.size(),
+           float_bytes);
+    report("NumberParser::Float", run(PARSER_FLOAT, floats, reps, check),
+           floats.size(), float_bytes);
+    report("strtol (faces)", run(STRTOL_FACE, faces, reps, check),
+           faces.size(), face_bytes);
+    report("NumberParser::Face", run(PARSER_FACE, faces, reps, check),
+           faces.size(), face_bytes);
+    printf("%lu rounding mismatches against strtof\n",
+           (unsigned long)mismatches);
+    return (mismatches == 0 ? 0 : 1);
+}
@@ -0,0 +1,286 @@
+/**
+ * vrml_parser:
+ * Benchmark of the streaming VrmlParser on a large .wrl file, against
+ * reading the whole file into memory and converting the numbers with
+ * strtof/strtol. Without a file, one with a few million faces is written to
+ * /tmp first, and the counts read back are checked against it. The peak
+ * memory use after each reader shows the parser's stays flat.
+ *
+ * Usage: bench/vrml_parser [file.wrl | faces] [repetitions]
+ */
+
+#include "generic/VrmlParser.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace cs354;
+
+static const long _default_faces = 2000000;
+static const int _shapes = 4;
+
+/* What a reader found */
+struct Totals {
+    Totals() : sets(0), points(0), faces(0), pointSum(0.0), indexSum(0.0)
+    { }
+    
+    size_t sets, points, faces;
+    /* Sums of the coordinates and of the indices */
+    double pointSum, indexSum;
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static long peak_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/* Writes a VRML 2.0 file of '_shapes' triangulated grids with about 'faces'
+ * faces between them, plus the fields and comments the parser has to skip.
+ * Returns what it wrote. */
+static Totals generate(const char *fname, long faces) {
+    FILE *fp = fopen(fname, "w");
+    if(fp == NULL) {
+        throw std::runtime_error(std::string("Could not write ") + fname);
+    }
+    Totals wrote;
+    long side = 1;
+    while(2 * side * side * _shapes < faces) {
+        side++;
+    }
+    fputs("#VRML V2.0 utf8\n# Generated by bench/vrml_parser\n", fp);
+    fputs("WorldInfo { title \"benchmark [grid]\" info [ \"a, b\" ] }\n", fp);
+    for(int s = 0; s < _shapes; ++s) {
+        fprintf(fp, "DEF Grid%d Transform {\n", s);
+        fprintf(fp, "  translation %d 0 0\n  children [\n", s * 2);
+        fputs("    Shape {\n      appearance Appearance {\n", fp);
+        fputs("        material Material { diffuseColor 1 1 0 }\n      }\n",
+              fp);
+        fputs("      geometry IndexedFaceSet {\n        solid FALSE\n", fp);
+        fputs("        coord Coordinate {\n          point [\n", fp);
+        for(long y = 0; y <= side; ++y) {
+            for(long x = 0; x <= side; ++x) {
+                float px = float(x) / side, py = float(y) / side;
+                float pz = 0.25f * px * py;
+                fprintf(fp, "            %.6f %.6f %.6f,\n", px, py, pz);
+                wrote.pointSum += px + py + pz;
+                wrote.points += 1;
+            }
+        }
+        fputs("          ]\n        }\n        coordIndex [\n", fp);
+        for(long y = 0; y < side; ++y) {
+            for(long x = 0; x < side; ++x) {
+                long a = y * (side + 1) + x, b = a + 1;
+                long c = a + side + 1, d = c + 1;
+                fprintf(fp, "          %ld, %ld, %ld, -1, "
+                        "%ld, %ld, %ld, -1,\n", a, b, d, a, d, c);
+                wrote.indexSum += double(a + b + d) + double(a + d + c);
+                wrote.faces += 2;
+            }
+        }
+        fputs("        ]\n      }\n    }\n  ]\n}\n", fp);
+        wrote.sets += 1;
+    }
+    fclose(fp);
+    return wrote;
+}
+
+static Totals parse_streaming(const char *fname) {
+    VrmlParser parser;
+    if(!parser.open(fname)) {
+        throw std::runtime_error(std::string("Could not open ") + fname);
+    }
+    Totals found;
+    VrmlFaceSet set;
+    while(parser.next(set)) {
+        found.sets += 1;
+        found.points += set.points.size() / 3;
+        found.faces += set.faces;
+        for(size_t i = 0; i < set.points.size(); ++i) {
+            found.pointSum += set.points[i];
+        }
+        for(size_t i = 0; i < set.coordIndex.size(); ++i) {
+            if(set.coordIndex[i] >= 0) {
+                found.indexSum += set.coordIndex[i];
+            }
+        }
+    }
+    return found;
+}
+
+/* The straightforward way: the whole file in memory, and strtof/strtol on
+ * whatever follows "point [" and "coordIndex [" */
+static Totals parse_slurped(const char *fname) {
+    FILE *fp = fopen(fname, "rb");
+    if(fp == NULL) {
+        throw std::runtime_error(std::string("Could not open ") + fname);
+    }
+    std::string text;
+    char chunk[1 << 16];
+    size_t got;
+    while((got = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        text.append(chunk, got);
+    }
+    fclose(fp);
+    
+    Totals found;
+    std::vector<float> points;
+    std::vector<int> indices;
+    const char *pos = text.c_str();
+    for(;;) {
+        const char *point = strstr(pos, "point [");
+        const char *index = strstr(pos, "coordIndex [");
+        if(point == NULL && index == NULL) {
+            break;
+        }
+        bool is_point = (index == NULL || (point != NULL && point < index));
+        pos = strchr(is_point ? point : index, '[') + 1;
+        for(;;) {
+            while(*pos == ' ' || *pos == '\n' || *pos == ',') {
+                pos++;
+            }
+            if(*pos == ']' || *pos == '\0') {
+                break;
+            }
+            char *stop;
+            if(is_point) {
+                points.push_back(strtof(pos, &stop));
+            }else {
+                indices.push_back(int(strtol(pos, &stop, 10)));
+            }
+            pos = stop;
+        }
+        if(is_point) {
+            found.points += points.size() / 3;
+            for(size_t i = 0; i < points.size(); ++i) {
+                found.pointSum += points[i];
+            }
+            points.clear();
+        }else {
+            found.sets += 1;
+            for(size_t i = 0; i < indices.size(); ++i) {
+                if(indices[i] >= 0) {
+                    found.indexSum += indices[i];
+                }else {
+                    found.faces += 1;
+                }
+            }
+            indices.clear();
+        }
+    }
+    return found;
+}
+
+typedef Totals (*Reader)(const char *fname);
+
+/* Returns the best time of 'reps' runs */
+static double run(Reader reader, const char *fname, int reps, Totals &found)
+{
+    double best = 1e30;
+    for(int r = 0; r < reps; ++r) {
+        double start = now();
+        found = reader(fname);
+        double elapsed = now() - start;
+        best = (elapsed < best ? elapsed : best);
+    }
+    return best;
+}
+
+static void report(const char *name, double secs, const Totals &found,
+                   size_t bytes)
+{
+    printf("  %-18s %8.2f ms %8.2f Mfaces/s %8.1f MB/s  peak %ld KB\n", name,
+           secs * 1e3, found.faces / (secs * 1e6),
+           bytes / (secs * 1024.0 * 1024.0), peak_kb());
+}
+
+/* The file only has six decimals of each coordinate */
+static bool same(const Totals &a, const Totals &b) {
+    double diff = a.pointSum - b.pointSum;
+    return (a.sets == b.sets && a.points == b.points && a.faces == b.faces &&
+            a.indexSum == b.indexSum &&
+            (diff < 0.0 ? -diff : diff) < 1e-6 * (a.points + 1));
+}
+
+int main(int argc, char **argv) {
+    std::string fname;
+    bool generated = false;
+    long faces = _default_faces;
+    if(argc > 1) {
+        char *stop;
+        long count = strtol(argv[1], &stop, 10);
+        if(*stop == '\0' && count > 0) {
+            faces = count;
+        }else {
+            fname = argv[1];
+        }
+    }
+    int reps = (argc > 2 ? atoi(argv[2]) : 3);
+    if(reps < 1) {
+        reps = 1;
+    }
+    
+    try {
+        Totals expected;
+        if(fname.empty()) {
+            char path[64];
+            snprintf(path, sizeof(path), "/tmp/vrml_parser_%d.wrl",
+                     int(getpid()));
+            fname = path;
+            printf("Writing %ld faces to %s\n", faces, path);
+            expected = generate(path, faces);
+            generated = true;
+        }
+        
+        FILE *fp = fopen(fname.c_str(), "rb");
+        if(fp == NULL) {
+            fprintf(stderr, "Could not open %s\n", fname.c_str());
+            return 1;
+        }
+        fseek(fp, 0, SEEK_END);
+        size_t bytes = size_t(ftell(fp));
+        fclose(fp);
+        
+        Totals streamed, slurped;
+        printf("%s: %.1f MB, best of %d, peak before %ld KB\n",
+               fname.c_str(), bytes / (1024.0 * 1024.0), reps, peak_kb());
+        report("VrmlParser", run(parse_streaming, fname.c_str(), reps,
+                                 streamed), streamed, bytes);
+        report("slurp + strtof", run(parse_slurped, fname.c_str(), reps,
+                                     slurped), slurped, bytes);
+        printf("%lu face sets, %lu points, %lu faces\n",
+               (unsigned long)streamed.sets, (unsigned long)streamed.points,
+               (unsigned long)streamed.faces);
+        
+        bool ok = (generated ? same(streamed, expected) : true);
+        if(!ok) {
+            fprintf(stderr, "Expected %lu face sets, %lu points, %lu faces\n",
+                    (unsigned long)expected.sets,
+                    (unsigned long)expected.points,
+                    (unsigned long)expected.faces);
+        }
+        if(generated) {
+            unlink(fname.c_str());
+        }
+        return (ok ? 0 : 1);
+    }catch(std::exception &err) {
+        fprintf(stderr, "%s\n", err.what());
+        if(generated) {
+            unlink(fname.c_str());
+        }
+        return 1;
+    }
+}
@@ -1,3 +1,7 @@
+#version 120
+#ifdef GL_ARB_uniform_buffer_object
+#extension GL_ARB_uniform_buffer_object : enable
+#endif
 
 // out
 varying vec3 LightIntensity;
@@ -11,27 +15,51 @@ struct LightInfo {
 };
 uniform LightInfo Light;
 
+struct MaterialInfo {
+    vec3 Ka;
+    float Tr;
+    vec3 Kd;
+    vec3 Ks;
+    float Ns;
+};
+// The bound MaterialTable where there are uniform buffers, otherwise the
+// material's own uniforms
+#ifdef GL_ARB_uniform_buffer_object
+layout(std140) uniform Materials {
+    MaterialInfo Material[256];
+};
+uniform int MaterialIndex;
+#define CURRENT_MATERIAL Material[MaterialIndex]
+#else
 uniform vec3 Ka;
+uniform float Tr;
 uniform vec3 Kd;
 uniform vec3 Ks;
-uniform float Tr;
 uniform float Ns;
+#define CURRENT_MATERIAL MaterialInfo(Ka, Tr, Kd, Ks, Ns)
+#endif
+
+// Dequantize compact model positions; offset 0 and scale 1 change nothing
+uniform vec3 QuantOffset;
+uniform float QuantScale;
 
 void main()
 {
+    MaterialInfo mat = CURRENT_MATERIAL;
+    vec4 position = vec4(gl_Vertex.xyz * QuantScale + QuantOffset, 1.0);
     vec3 tnorm = normalize( gl_NormalMatrix * gl_Normal);
-    vec4 eyeCoords = gl_ModelViewMatrix * vec4(gl_Vertex);
+    vec4 eyeCoords = gl_ModelViewMatrix * position;
     //vec3 s = normalize(vec3(Light.Position * gl_ModelViewMatrix - eyeCoords));
     vec3 s = normalize(vec3(Light.Position - eyeCoords));
     vec3 v = normalize(-eyeCoords.xyz);
     vec3 r = reflect( -s, tnorm );
-    vec3 ambient = Light.La * Ka;
+    vec3 ambient = Light.La * mat.Ka;
     float sDotN = max(dot(s,tnorm), 0.0);
-    vec3 diffuse = Light.Ld * Kd * sDotN;
+    vec3 diffuse = Light.Ld * mat.Kd * sDotN;
     vec3 spec = vec3(0.0);
     if( sDotN > 0.0 ) {
-        spec = Light.Ls * Ks * pow(max(dot(r,v),0.0), Ns);
+        spec = Light.Ls * mat.Ks * pow(max(dot(r,v),0.0), mat.Ns);
     }
     LightIntensity = ambient + diffuse + spec;
-    gl_Position = gl_ModelViewProjectionMatrix * vec4(gl_Vertex);
+    gl_Position = gl_ModelViewProjectionMatrix * position;
 }
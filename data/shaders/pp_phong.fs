@@ -1,3 +1,7 @@
+#version 120
+#ifdef GL_ARB_uniform_buffer_object
+#extension GL_ARB_uniform_buffer_object : enable
+#endif
 
 varying vec3 Normal;
 varying vec3 Vertex;
@@ -10,25 +14,45 @@ struct LightInfo {
 };
 uniform LightInfo Light;
 
+struct MaterialInfo {
+    vec3 Ka;
+    float Tr;
+    vec3 Kd;
+    vec3 Ks;
+    float Ns;
+};
+// The bound MaterialTable where there are uniform buffers, otherwise the
+// material's own uniforms
+#ifdef GL_ARB_uniform_buffer_object
+layout(std140) uniform Materials {
+    MaterialInfo Material[256];
+};
+uniform int MaterialIndex;
+#define CURRENT_MATERIAL Material[MaterialIndex]
+#else
 uniform vec3 Ka;
+uniform float Tr;
 uniform vec3 Kd;
 uniform vec3 Ks;
-uniform float Tr;
 uniform float Ns;
+#define CURRENT_MATERIAL MaterialInfo(Ka, Tr, Kd, Ks, Ns)
+#endif
 
 void main(void) {
-    vec4 eyeCoords = gl_ModelViewMatrix * vec4(Vertex, 1);
+    MaterialInfo mat = CURRENT_MATERIAL;
+    // Vertex is already in eye space
+    vec4 eyeCoords = vec4(Vertex, 1);
     //vec4 LightPos = (Light.Position - eyeCoords) * gl_ModelViewMatrix;
     vec4 LightPos = Light.Position - eyeCoords;
     vec3 s = normalize(vec3(LightPos));
     vec3 v = normalize(-eyeCoords.xyz);
     vec3 r = reflect(-s, Normal);
-    vec3 ambient = Light.La * Ka;
+    vec3 ambient = Light.La * mat.Ka;
     float sDotN = max(dot(s,Normal), 0.0);
-    vec3 diffuse = Light.Ld * Kd * sDotN;
+    vec3 diffuse = Light.Ld * mat.Kd * sDotN;
     vec3 spec = vec3(0.0);
     if( sDotN > 0.0 ) {
-        spec = Light.Ls * Ks * pow(max(dot(r,v),0.0), Ns);
+        spec = Light.Ls * mat.Ks * pow(max(dot(r,v),0.0), mat.Ns);
     }
     gl_FragColor = vec4(ambient + diffuse + spec, 1.0);
 }
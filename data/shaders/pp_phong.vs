@@ -2,9 +2,14 @@
 varying vec3 Normal;
 varying vec3 Vertex;
 
+// Dequantize compact model positions; offset 0 and scale 1 change nothing
+uniform vec3 QuantOffset;
+uniform float QuantScale;
+
 void main(void)
 {
-    Vertex = vec3(gl_ModelViewMatrix * gl_Vertex);
+    vec4 position = vec4(gl_Vertex.xyz * QuantScale + QuantOffset, 1.0);
+    Vertex = vec3(gl_ModelViewMatrix * position);
     Normal = normalize(gl_NormalMatrix * gl_Normal);
-    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+    gl_Position = gl_ModelViewProjectionMatrix * position;
 }
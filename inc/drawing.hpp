@@ -45,6 +45,9 @@ extern int disp_mode;
 extern cs354::Shader *shader;
 extern cs354::Model *model;
 extern bool draw_model;
+/* Draw the cube, cone and vrml modes the original way, in immediate mode or
+ * from client arrays, rather than from buffered meshes */
+extern bool draw_immediate;
 
 /* Styles of drawing glut objects, either solid or wire-frame */
 enum DrawStyle {
@@ -60,12 +63,15 @@ extern int disp_style;
 /* Function Declarations */
 void myInit(int argc, char **argv);
 void myDisplay();
+void myIdle();
 void myReshape(int width, int height);
 void myKeyHandler(unsigned char ch, int x, int y);
 void resetCamera(void);
 int endCanvas(int status);
 void performanceTest();
 void initLighting();
+void init_static_geometry();
+bool has_immediate_variant(int mode);
 
 void draw_cube_glut();
 void draw_cube_quad();
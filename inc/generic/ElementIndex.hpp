@@ -0,0 +1,49 @@
+
+#ifndef CS354_GENERIC_ELEMENT_INDEX_HPP
+#define CS354_GENERIC_ELEMENT_INDEX_HPP
+
+#include "Geometry.hpp"
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace cs354 {
+    /* Maps distinct v/vt/vn element triples to model indices.
+     * This is an open addressing (linear probing) hash table. The triple is
+     * packed into a 64 bit key for v/vt plus the vn, so a lookup is a hash
+     * and usually a single slot comparison, with no allocation per entry.
+     */
+    class ElementIndex {
+    public:
+        /* Size the table up front for about 'expected' distinct elements */
+        ElementIndex(size_t expected);
+        ~ElementIndex();
+        
+        /* Find the index of the element, adding it with the index 'next' if
+         * it isn't in the table yet. 'inserted' is set to true if the
+         * element was added. */
+        GLuint insert(const Element &e, GLuint next, bool &inserted);
+        
+        /* Statistics */
+        size_t size() const;
+        size_t capacity() const;
+        size_t lookups() const;
+        size_t probes() const;
+    private:
+        struct Slot {
+            uint64_t key; /*< v + 1 in the low word, vt + 1 in the high */
+            uint32_t vn;  /*< vn + 1 */
+            GLuint value; /*< Empty slots hold EMPTY */
+        };
+        static const GLuint EMPTY = 0xFFFFFFFFu;
+        
+        void grow();
+        
+        std::vector<Slot> slots;
+        size_t mask, count;
+        size_t nlookups, nprobes;
+    };
+}
+
+#endif
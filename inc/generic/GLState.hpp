@@ -0,0 +1,96 @@
+
+#ifndef CS354_GENERIC_GL_STATE_HPP
+#define CS354_GENERIC_GL_STATE_HPP
+
+#include "../common.hpp"
+
+#include <cstddef>
+
+namespace cs354 {
+    /* Calls GLState issued to the GL, and those it left out because the
+     * state was already set, by the kind of state */
+    struct GLCounters {
+        enum Kind {
+            PROGRAM,
+            BUFFER,
+            TEXTURE,
+            ARRAY,      /*< Vertex array objects and client arrays */
+            CAPABILITY,
+            UNIFORM,
+            KINDS
+        };
+        
+        GLCounters();
+        
+        size_t totalIssued() const;
+        size_t totalFiltered() const;
+        
+        size_t issued[KINDS];
+        size_t filtered[KINDS];
+    };
+    
+    /* Remembers the GL state set through it and skips calls that wouldn't
+     * change anything: the program in use, the array, element and uniform
+     * buffer bindings, the 2D texture, the vertex array object, the client
+     * arrays, enabled capabilities, and uniform values set by location.
+     * Everything starts out unknown, so the first call for each is always
+     * issued.
+     *
+     * The cache is only right while all of that state goes through here.
+     * Code that changes it directly, without putting it back the way it was,
+     * has to call Reset() afterwards.
+     */
+    class GLState {
+    public:
+        static void UseProgram(GLuint program);
+        /* Asks the GL only if the program in use isn't known */
+        static GLuint CurrentProgram();
+        /* For programs that are deleted or relinked: drops their uniform
+         * values, and forgets the program in use if it's this one */
+        static void ForgetProgram(GLuint program);
+        
+        /* The element array binding is part of the vertex array object, so
+         * it's forgotten when another one is bound, like the client arrays
+         */
+        static void BindBuffer(GLenum target, GLuint buffer);
+        static void BindBufferRange(GLenum target, GLuint index,
+                                    GLuint buffer, GLintptr offset,
+                                    GLsizeiptr size);
+        static void DeleteBuffers(GLsizei n, const GLuint *buffers);
+        
+        static void BindTexture(GLenum target, GLuint texture);
+        static void DeleteTextures(GLsizei n, const GLuint *textures);
+        
+        static void BindVertexArray(GLuint array);
+        static void DeleteVertexArrays(GLsizei n, const GLuint *arrays);
+        static void EnableClientState(GLenum array);
+        static void DisableClientState(GLenum array);
+        
+        static void Enable(GLenum cap);
+        static void Disable(GLenum cap);
+        /* Asks the GL only if the capability isn't known */
+        static bool IsEnabled(GLenum cap);
+        
+        /* Uniforms of the program in use. Locations of -1 are ignored, like
+         * the GL does. The values are kept for each program, so switching
+         * back to one doesn't send them again. */
+        static void Uniform1i(GLint location, GLint x);
+        static void Uniform1f(GLint location, GLfloat x);
+        static void Uniform3f(GLint location, GLfloat x, GLfloat y,
+                              GLfloat z);
+        static void Uniform4f(GLint location, GLfloat x, GLfloat y,
+                              GLfloat z, GLfloat w);
+        
+        /* Forgets everything, so the next call for each state is issued */
+        static void Reset();
+        
+        /* For callers that filter calls themselves, so they show up in the
+         * counters */
+        static void Count(GLCounters::Kind kind, bool issued);
+        /* Counted since the last ResetCounters() */
+        static const GLCounters & Counters();
+        static void ResetCounters();
+    };
+}
+
+#endif
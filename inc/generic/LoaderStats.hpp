@@ -0,0 +1,93 @@
+
+#ifndef CS354_GENERIC_LOADER_STATS_HPP
+#define CS354_GENERIC_LOADER_STATS_HPP
+
+#include "VertexCache.hpp"
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+
+/* Whether allocations are counted, by replacing the global operator new.
+ * Every allocation in the program then pays for two atomic adds on shared
+ * counters, so it's off unless built with -DCS354_COUNT_ALLOCS=1; without
+ * it every phase reports no allocations. */
+#ifndef CS354_COUNT_ALLOCS
+# define CS354_COUNT_ALLOCS 0
+#endif
+
+namespace cs354 {
+    /* Time and allocations spent in one phase of a load */
+    struct PhaseStats {
+        PhaseStats();
+        
+        double seconds;
+        uint64_t allocations, bytes;
+    };
+    
+    /* What a WavefrontLoader did to produce its last Model. Phases that
+     * didn't run are left at zero, so a model read from the binary cache
+     * only has CACHE (and UPLOAD, once it has been uploaded) filled in.
+     */
+    struct LoaderStats {
+        enum Phase {
+            READ,      /*< Opening and mapping the source file */
+            PARSE,     /*< Tokenizing and parsing, including mtllib */
+            RESOLVE,   /*< Merging parallel parse chunks and resolving
+                        *  their face indices. The serial parsers resolve
+                        *  faces as they go, which counts as PARSE. */
+            TRANSFORM, /*< Recentering and rescaling the vertices */
+            DEDUP,     /*< Building the Model's arrays from unique corners */
+            OPTIMIZE,  /*< Reordering for the vertex cache, if asked for */
+            CACHE,     /*< Reading or writing the binary model cache */
+            UPLOAD,    /*< Sending the Model to the GPU */
+            PHASE_COUNT
+        };
+        static const char * PhaseName(Phase phase);
+        
+        /* Allocations made through operator new by the whole process so
+         * far, or 0 without CS354_COUNT_ALLOCS. These are what the phase
+         * allocation counts are made of, so a phase also counts anything
+         * other threads allocated meanwhile. */
+        static uint64_t Allocations();
+        static uint64_t AllocatedBytes();
+        /* Monotonic wall clock, in seconds */
+        static double Now();
+        
+        LoaderStats();
+        void reset();
+        
+        /* Writes the statistics as a single JSON object */
+        void writeJSON(FILE *fp) const;
+        
+        std::string file;
+        /* Whether the model came out of the binary cache */
+        bool cached;
+        /* Wall time of the whole load, which the phases are a part of */
+        double total;
+        PhaseStats phases[PHASE_COUNT];
+        
+        /* Sizes of the resulting Model */
+        uint64_t objects, groups, materials;
+        uint64_t vertices, normals, texcoords, triangles;
+        /* Face corners seen by the deduplication, and how many were unique */
+        uint64_t corners, distinct;
+        /* Simulated vertex cache use before and after OPTIMIZE. Both are
+         * zero if the model wasn't optimized while loading it. */
+        CacheMetrics unoptimized, optimized;
+    };
+    
+    /* Adds the time and allocations between its construction and
+     * destruction to one phase. */
+    class PhaseTimer {
+    public:
+        PhaseTimer(LoaderStats &stats, LoaderStats::Phase phase);
+        ~PhaseTimer();
+    private:
+        PhaseStats &target;
+        double start;
+        uint64_t allocations, bytes;
+    };
+}
+
+#endif
@@ -0,0 +1,38 @@
+
+#ifndef CS354_GENERIC_MAPPED_FILE_HPP
+#define CS354_GENERIC_MAPPED_FILE_HPP
+
+#include <cstddef>
+
+namespace cs354 {
+    /* Read-only view of an entire file. The file is mapped into memory with
+     * mmap, so parsers can walk it as one big character array without any
+     * intermediate buffering or copying.
+     */
+    class MappedFile {
+    public:
+        MappedFile();
+        MappedFile(const char *fname);
+        ~MappedFile();
+        
+        /* Map the given file, unmapping anything previously mapped. Returns
+         * false if the file could not be opened or mapped. */
+        bool open(const char *fname);
+        void close();
+        
+        bool valid() const;
+        const char * data() const;
+        const char * end() const;
+        size_t size() const;
+    private:
+        /* Not copyable; the mapping is owned by exactly one object */
+        MappedFile(const MappedFile &);
+        MappedFile & operator=(const MappedFile &);
+        
+        const char *begin;
+        size_t length;
+        bool mapped;
+    };
+}
+
+#endif
@@ -31,12 +31,23 @@ namespace cs354 {
         static GLint Ks();
         static GLint Tr();
         static GLint Ns();
+        /* Whether the shader reads materials from a MaterialTable, and the
+         * location of its MaterialIndex */
+        static bool Table();
+        static GLint Index();
+        /* Where the shader turns compact positions back into model space,
+         * from its QuantOffset and QuantScale; -1 if it doesn't */
+        static GLint QuantOffset();
+        static GLint QuantScale();
         
         /* Non-static interface */
         MaterialLocations();
         ~MaterialLocations();
         
         GLint loc_ka, loc_kd, loc_ks, loc_tr, loc_ns;
+        GLuint block;
+        GLint loc_index;
+        GLint loc_quant_offset, loc_quant_scale;
     private:
         static const MaterialLocations * current_locations;
     };
@@ -0,0 +1,61 @@
+
+#ifndef CS354_GENERIC_MATERIAL_LIBRARY_HPP
+#define CS354_GENERIC_MATERIAL_LIBRARY_HPP
+
+#include "../common.hpp"
+#include "Material.hpp"
+
+#include <map>
+#include <string>
+
+namespace cs354 {
+    /* The materials defined by one .mtl file.
+     * Libraries are parsed once per process and shared: Load() keeps every
+     * library it reads in a table keyed by the file's canonical path, and
+     * hands out the same library until the file's size or modification time
+     * changes. Once published a library is never modified or freed, so Models
+     * can point straight at its Materials. A library that is replaced after
+     * its file changes stays allocated for any Models still using it.
+     */
+    class MaterialLibrary {
+    public:
+        /* Returns the library for the given file, parsing it if it isn't
+         * loaded or has changed. Returns NULL if the file can't be opened
+         * and throws if it can't be parsed. Safe to call from any thread. */
+        static const MaterialLibrary * Load(const std::string &fname);
+        
+        /* Returns NULL if the library doesn't define the material */
+        const Material * get(const std::string &name) const;
+        const std::map<std::string, Material> & materials() const;
+        /* Canonical path the library was read from */
+        const std::string & path() const;
+        
+        /* Interface for the material parser, only used while loading */
+        void newmtl(const char *mtlname);
+        void ka(GLfloat color[3]);
+        void kd(GLfloat color[3]);
+        void ks(GLfloat color[3]);
+        void ns(GLfloat amount);
+        void tr(GLfloat amount);
+    private:
+        MaterialLibrary(const std::string &path);
+        ~MaterialLibrary();
+        
+        /* Parses the file, throwing on failure */
+        void parse();
+        /* Moves the material being read into the table */
+        void flush();
+        
+        std::string filename;
+        std::map<std::string, Material> table;
+        
+        /* Material currently being read */
+        struct {
+            bool valid;
+            std::string name;
+            Material def;
+        } mat;
+    };
+}
+
+#endif
@@ -0,0 +1,72 @@
+
+#ifndef CS354_GENERIC_MATERIAL_TABLE_HPP
+#define CS354_GENERIC_MATERIAL_TABLE_HPP
+
+#include "../common.hpp"
+#include "Material.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace cs354 {
+    /* A Model's materials in a uniform buffer, so switching materials
+     * between draws is one integer uniform instead of five vectors. Shaders
+     * read the table through this block, std140 layout:
+     *
+     *   struct MaterialInfo {
+     *       vec3 Ka;
+     *       float Tr;
+     *       vec3 Kd;
+     *       vec3 Ks;
+     *       float Ns;
+     *   };
+     *   layout(std140) uniform Materials {
+     *       MaterialInfo Material[256];
+     *   };
+     *   uniform int MaterialIndex;
+     *
+     * Shader::link() binds the block to Binding. Tables larger than Size are
+     * bound a window of Size materials at a time.
+     */
+    class MaterialTable {
+    public:
+        /* Uniform buffer binding point of the Materials block */
+        static const GLuint Binding;
+        /* Length of the Material array in the shaders */
+        static const size_t Size;
+        
+        /* Whether the GL has uniform buffers: 3.1, or the ARB extension */
+        static bool Supported();
+        /* Finds the Materials block and MaterialIndex uniform of a linked
+         * program, and binds the block to Binding */
+        static void Locate(GLuint program, MaterialLocations &locations);
+        /* Selects a single material, for drawing outside of a Model. It
+         * goes through a shared one material table. */
+        static void BindSingle(const Material &mat);
+        
+        MaterialTable();
+        ~MaterialTable();
+        
+        /* Copies the materials into a new uniform buffer; their indices in
+         * the table are their indices in the vector. Needs a current GL
+         * context, and release() has to be called while it's current. */
+        void upload(const std::vector<const Material *> &materials);
+        void release();
+        bool uploaded() const;
+        
+        /* Binds the buffer to Binding; done once before select() */
+        void bind();
+        /* Sets MaterialIndex to the material, moving the window first if
+         * it's outside of it */
+        void select(size_t index);
+    private:
+        void bind_window(size_t first);
+        
+        GLuint buffer;
+        /* Windows start at multiples of 'step' materials, which keeps their
+         * offsets aligned for glBindBufferRange */
+        size_t step, window;
+    };
+}
+
+#endif
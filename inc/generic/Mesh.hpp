@@ -0,0 +1,59 @@
+
+#ifndef CS354_GENERIC_MESH_HPP
+#define CS354_GENERIC_MESH_HPP
+
+#include "../common.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace cs354 {
+    /* Indexed geometry made by the program rather than loaded, like the
+     * calculated cone. The arrays are filled in directly, with triangles for
+     * drawing it solid and pairs of line indices for its wireframe. Normals
+     * and colors are optional, one for each vertex if there are any. Once
+     * uploaded, each draw is a single glDrawElements from buffer objects;
+     * before that the arrays are drawn from memory.
+     */
+    class Mesh {
+    public:
+        Mesh();
+        ~Mesh();
+        
+        /* Empties the arrays. Uploaded buffers are kept until release() or
+         * the next upload(). */
+        void clear();
+        /* Copies the arrays into buffer objects, replacing those of any
+         * earlier upload(). Needs a current GL context, and release() has to
+         * be called while it's current. */
+        void upload();
+        void release();
+        bool uploaded() const;
+        
+        void drawTriangles();
+        void drawLines();
+        
+        std::vector<GLfloat> vertices; /*< Triplet */
+        std::vector<GLfloat> normals;  /*< Triplet */
+        std::vector<GLfloat> colors;   /*< Triplet */
+        std::vector<GLuint> triangles; /*< Triplet */
+        std::vector<GLuint> lines;     /*< Pair */
+    private:
+        /* Meshes own their buffers, so they aren't copied */
+        Mesh(const Mesh &other);
+        Mesh & operator=(const Mesh &other);
+        
+        void draw(GLenum mode, const std::vector<GLuint> &indices,
+                  GLsizei count, GLintptr offset);
+        
+        GLuint vbo, ibo;
+        /* What was uploaded: the size of a vertex, the index counts, where
+         * the normal and color are in a vertex (0 for neither), and where
+         * the lines start in the index buffer */
+        GLsizei stride;
+        GLsizei triangleCount, lineCount;
+        GLintptr normalOffset, colorOffset, lineOffset;
+    };
+}
+
+#endif
@@ -4,8 +4,11 @@
 
 #include "../common.hpp"
 #include "Material.hpp"
+#include "MaterialTable.hpp"
+#include "SymbolTable.hpp"
+#include "VertexOps.hpp"
 
-#include <list>
+#include <cstddef>
 #include <map>
 #include <stdint.h>
 #include <string>
@@ -16,8 +19,9 @@ namespace cs354 {
      * A model consists of groups of polygons which may have any number of
      * different materials associated with them.
      * The vertices, normals and texture coordinates are all a part of the base
-     * model, but the elements composing the polygons are stored in the lowest
-     * layer (the Material Group of the Polygon Group of the Model).
+     * model, and so are the elements composing the polygons; the lowest layer
+     * (the Material Group of the Polygon Group of the Model) is a range of
+     * them.
      * In any case, this file is a huge beast, as I define everything a model
      * needs in it. Technically, Materials can be used outside of a model
      * but I don't do so in this project so I left it here.
@@ -28,64 +32,230 @@ namespace cs354 {
         GLfloat x, y, z;
     };
     
-    struct MaterialGroup {
-        MaterialGroup(const std::string &name,
-                      const Material &mat = Material::Default);
-        ~MaterialGroup();
+    /* The Model keeps its hierarchy in flat tables: objects index into the
+     * group table, groups into the range table, and each range is one
+     * material group's slice of the Model's single element array. Everything
+     * is stored in order, so an object's groups, a group's material groups
+     * and their elements are all contiguous. Names are symbols of the
+     * Model's SymbolTable.
+     */
+    struct ModelObject {
+        Symbol name;
+        uint32_t first, count; /*< Groups */
+    };
+    struct ModelGroup {
+        Symbol name;
+        uint32_t object;
+        uint32_t first, count; /*< Ranges */
+    };
+    struct ModelRange {
+        Symbol name;           /*< The material's name */
+        uint32_t object, group;
+        const Material *mat;
+        GLuint first, count;   /*< Elements */
+    };
+    
+    /* Read-only views of one entry of the tables. They hold the Model and an
+     * index, so they're cheap to copy, and stay valid as long as the Model.
+     * Lookups by name are hashed, and may also be done with a symbol from
+     * the Model's names(). Those that find nothing return a view that isn't
+     * valid(). If names repeat, the first entry with the name is found. */
+    class MaterialGroup {
+    public:
+        MaterialGroup();
+        MaterialGroup(const Model *model, size_t index);
         
+        bool valid() const;
         /* The material name, used as the name of the group */
-        const std::string name;
-        /* The material reference. */
-        const Material &mat;
-        std::vector<GLuint> elements;
+        const std::string & name() const;
+        const Material & material() const;
+        const GLuint * elements() const;
+        size_t size() const;
+    private:
+        const Model *model;
+        size_t index;
     };
-    
-    struct Group {
-        Group(const std::string &name, const Model *owner);
-        ~Group();
+    class Group {
+    public:
+        Group();
+        Group(const Model *model, size_t index);
         
-        MaterialGroup & get(const char *name);
-        MaterialGroup & get(const std::string &name);
+        bool valid() const;
+        const std::string & name() const;
+        /* Material groups */
+        size_t size() const;
+        MaterialGroup at(size_t i) const;
+        MaterialGroup get(const char *name) const;
+        MaterialGroup get(const std::string &name) const;
+        MaterialGroup get(Symbol name) const;
+    private:
+        const Model *model;
+        size_t index;
+    };
+    class Object {
+    public:
+        Object();
+        Object(const Model *model, size_t index);
         
-        std::string name;
-        std::list<MaterialGroup> matgroups;
-        const Model *owner;
+        bool valid() const;
+        const std::string & name() const;
+        /* Groups */
+        size_t size() const;
+        Group at(size_t i) const;
+        Group get(const char *name) const;
+        Group get(const std::string &name) const;
+        Group get(Symbol name) const;
+    private:
+        const Model *model;
+        size_t index;
     };
-    struct Object {
-        Object(const std::string &name, const Model *owner);
-        ~Object();
+    
+    /* Every material group drawn with one material. Once uploaded the
+     * groups are next to each other in the index buffer, so there is a
+     * single range; otherwise neighboring groups are merged and the rest are
+     * drawn with one glMultiDrawElements. */
+    struct DrawBatch {
+        DrawBatch(const Material *mat);
+        ~DrawBatch();
         
-        Group & get(const std::string &name);
-        Group & get(const char *name);
+        const Material *mat;
+        /* Entries of the Model's range table */
+        std::vector<size_t> ranges;
+        /* Index buffer offsets or element pointers, and their lengths */
+        std::vector<const GLvoid *> indices;
+        std::vector<GLsizei> counts;
+    };
+    
+    /* What each draw() of a Model issues, and what drawing every material
+     * group on its own would have */
+    struct DrawCounters {
+        DrawCounters();
         
-        std::string name;
-        std::list<Group> groups;
-        const Model *owner;
+        size_t draws, binds;
+        size_t groups;
     };
     
+    class ModelCache;
     class ModelParserState;
     class WavefrontLoader;
     class Model {
     public:
+        /* How upload() lays out the vertex buffer */
+        enum VertexFormat {
+            /* Separate float arrays; 32 bytes a vertex with normals and
+             * texture coordinates */
+            FORMAT_FLOAT,
+            /* 16 byte interleaved vertices: 16 bit positions within the
+             * bounding box, 16 bit normals and half float texture
+             * coordinates. Needs GL 3.0 or ARB_half_float_vertex, and falls
+             * back to FORMAT_FLOAT without them. Shaders dequantize the
+             * positions with gl_Vertex.xyz * QuantScale + QuantOffset,
+             * which draw() sets; under the fixed function pipeline the
+             * modelview matrix does it. */
+            FORMAT_COMPACT
+        };
+        
         Model();
         ~Model();
         
-        Object & get(const std::string &name);
-        Object & get(const char *name);
+        /* Objects */
+        size_t size() const;
+        Object at(size_t i) const;
+        Object get(const std::string &name) const;
+        Object get(const char *name) const;
+        Object get(Symbol name) const;
+        /* Every name used by the Model */
+        const SymbolTable & names() const;
         
+        /* Copies the arrays and elements into buffer objects, after which
+         * draw() sources everything from them instead of sending the arrays
+         * every frame. The copies in memory are kept. Needs a current GL
+         * context, and the buffers belong to that context. */
+        void upload(VertexFormat format = FORMAT_FLOAT);
+        /* Deletes the buffer objects, going back to client-side arrays */
+        void release();
+        bool uploaded() const;
+        /* Bounds of the vertices, in model space */
+        BoundingBox bounds() const;
+        
+        /* Draws each material once. Material groups are batched on first
+         * use, so the groups shouldn't change after drawing or uploading.
+         * With a shader that reads a MaterialTable, the batches' materials
+         * are uploaded into one the first time, and each batch selects its
+         * material by index. */
         void draw();
+        const DrawCounters & drawCounters();
         
         const Material * getMaterial(const char *name) const;
         const Material * getMaterial(const std::string &name) const;
         
+        friend class ModelCache;
         friend class ModelParserState;
         friend class WavefrontLoader;
+        friend class MaterialGroup;
+        friend class Group;
+        friend class Object;
     protected:
+        /* Building the tables. Each call starts a new entry under the last
+         * one added, so a model is built object by object, and a range's
+         * elements must already be in the element array. Unknown materials
+         * are drawn with Material::Default. */
+        void add_object(Symbol name);
+        void add_group(Symbol name);
+        void add_range(Symbol material, GLuint first, GLuint count);
+        
         std::vector<GLfloat> vertices; /*< Triplet */
         std::vector<GLfloat> normals; /*< Triplet */
         std::vector<GLfloat> texture; /*< Pair */
-        std::list<Object> objects;
-        std::map<std::string, Material> materials;
+        /* Every material group's elements, in order */
+        std::vector<GLuint> elements;
+        std::vector<ModelObject> objects;
+        std::vector<ModelGroup> groups;
+        std::vector<ModelRange> ranges;
+        /* Names of the objects, groups and material groups, and the
+         * entries by name: objects are keyed by 0, groups by their object,
+         * and ranges by their group */
+        SymbolTable symbols;
+        SymbolIndex objectIndex, groupIndex, rangeIndex;
+        /* Shared, immutable entries of the MaterialLibrary they came from */
+        std::map<std::string, const Material *> materials;
+    private:
+        /* Whether there is a normal or texture coordinate for every vertex */
+        bool draws_normals() const;
+        bool draws_texture() const;
+        /* Fill the bound vertex buffer in either format */
+        void upload_float();
+        void upload_compact();
+        /* Sets up the array pointers, either into the vertex buffer or into
+         * client memory. */
+        void bind_arrays();
+        void bind_compact_arrays();
+        void unbind_arrays();
+        /* Collects the ranges into batches, in the order their materials
+         * are first used */
+        void batch_groups();
+        /* Points the batches at the index buffer or the elements */
+        void batch_ranges();
+        /* Fills the material table, in batch order */
+        void upload_materials();
+        
+        /* Buffer objects, 0 until upload(). In FORMAT_FLOAT the vertex
+         * buffer holds the vertices, then the normals and texture
+         * coordinates, if they're drawn at all; in FORMAT_COMPACT it holds
+         * CompactVertex structs. The vertex array object is only used where
+         * the GL supports it. */
+        GLuint vbo, ibo, vao;
+        VertexFormat vertexFormat;
+        /* Where the normals and texture coordinates start in FORMAT_FLOAT */
+        GLintptr normalOffset, textureOffset;
+        /* Model space position = quantOffset + quantScale * compact position
+         */
+        GLfloat quantOffset[3], quantScale;
+        
+        std::vector<DrawBatch> batches;
+        bool batched;
+        MaterialTable materialTable;
+        DrawCounters counters;
     };
 }
 
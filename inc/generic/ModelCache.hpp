@@ -0,0 +1,66 @@
+
+#ifndef CS354_GENERIC_MODEL_CACHE_HPP
+#define CS354_GENERIC_MODEL_CACHE_HPP
+
+#include "../common.hpp"
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cs354 {
+    class Model;
+    
+    /* The load parameters a cached model was built with. A cache file is
+     * only used if these match exactly. */
+    struct CacheKey {
+        CacheKey();
+        
+        uint32_t flags;
+        GLfloat origin[3];
+        GLfloat max_dim;
+    };
+    
+    /* Versioned binary container for fully loaded Models, kept next to the
+     * source file as "<source>.cache".
+     * The file holds the final vertex, normal and texture coordinate arrays,
+     * a single index array for every material group, the object, group and
+     * material group tables as ranges into those, the material table and the
+     * material libraries the model was built from. Each section is aligned so
+     * it can be read straight out of the mapped file; loading is a check of
+     * the header and tables followed by bulk copies into the Model.
+     * A cache is stale if the size or modification time of the source or any
+     * of its material libraries changed. If only the modification time of the
+     * source changed, its contents are hashed and compared instead, and the
+     * cache takes the new time if they match. The arrays of a cache are
+     * checked against each other before they're used, so a damaged file is
+     * rejected rather than drawn.
+     */
+    class ModelCache {
+    public:
+        /* CacheKey flags */
+        enum {
+            TRANSLATED = 1,
+            SCALED     = 2,
+            OPTIMIZED  = 4  /*< Reordered for the vertex cache */
+        };
+        static const uint32_t Version;
+        
+        /* Where the cache for the given source file lives */
+        static std::string Path(const char *source);
+        
+        /* Returns NULL if there is no valid cache for the source and key. */
+        static Model * Load(const char *source, const CacheKey &key);
+        /* Writes the cache file atomically, returning false on failure.
+         * 'depends' lists the material libraries read for the model. */
+        static bool Save(const char *source, const Model &model,
+                         const CacheKey &key,
+                         const std::vector<std::string> &depends);
+        
+        /* 64 bit FNV-1a, run over whole words where possible */
+        static uint64_t Hash(const char *data, size_t len);
+    };
+}
+
+#endif
@@ -0,0 +1,72 @@
+
+#ifndef CS354_GENERIC_MODEL_FUTURE_HPP
+#define CS354_GENERIC_MODEL_FUTURE_HPP
+
+#include "ModelCache.hpp"
+
+#include <pthread.h>
+#include <string>
+
+namespace cs354 {
+    class Model;
+    class WavefrontLoader;
+    
+    /* Handle to a model being loaded on its own thread, created by
+     * WavefrontLoader::loadAsync(). Poll state() from the render loop and
+     * take() the model once it is READY; nothing here touches GL, so any
+     * uploading is left to the thread that takes the model.
+     * The loader that started the load must not be used or destroyed until
+     * the load has finished.
+     */
+    class ModelFuture {
+    public:
+        enum State {
+            LOADING,
+            READY,
+            FAILED
+        };
+        
+        /* Waits for the load to finish, deleting the model if it was never
+         * taken. */
+        ~ModelFuture();
+        
+        /* Never blocks */
+        State state();
+        /* Blocks until the load has finished */
+        State wait();
+        /* Hands over the loaded model. Returns NULL unless the load is READY
+         * and the model hasn't been taken yet. */
+        Model * take();
+        /* Why the load FAILED */
+        const std::string & error() const;
+        
+        friend class WavefrontLoader;
+    private:
+        ModelFuture(WavefrontLoader *loader, const char *fname,
+                    const CacheKey &key);
+        
+        /* Not copyable */
+        ModelFuture(const ModelFuture &);
+        ModelFuture & operator=(const ModelFuture &);
+        
+        static void * Worker(void *future);
+        void run();
+        void join();
+        
+        WavefrontLoader *loader;
+        std::string fname;
+        CacheKey key;
+        
+        /* Written by the worker, guarded by lock */
+        State current;
+        Model *model;
+        std::string message;
+        
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t finished;
+        bool joinable;
+    };
+}
+
+#endif
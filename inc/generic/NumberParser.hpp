@@ -0,0 +1,31 @@
+
+#ifndef CS354_GENERIC_NUMBER_PARSER_HPP
+#define CS354_GENERIC_NUMBER_PARSER_HPP
+
+#include <cstddef>
+
+namespace cs354 {
+    /* Decimal number parsing for the model formats, without strtod's locale
+     * handling or the need for null terminated input. Digits are consumed
+     * eight at a time with SWAR (SIMD within a register) arithmetic where
+     * the input allows it.
+     * Each function parses from the start of [pos, end), returning a pointer
+     * just past what it consumed, or NULL if there is no number there.
+     */
+    class NumberParser {
+    public:
+        /* [+-]?[0-9]+ */
+        static const char * Int(const char *pos, const char *end, int &val);
+        /* [+-]?[0-9]+(\.[0-9]*)?([eE][+-]?[0-9]+)?
+         * Correctly rounded to nearest, the same as strtof in the C locale.
+         */
+        static const char * Float(const char *pos, const char *end,
+                                  float &val);
+        /* Face arguments; v, v/vt, v//vn or v/vt/vn. Missing indices are 0.
+         */
+        static const char * Face(const char *pos, const char *end,
+                                 int args[3]);
+    };
+}
+
+#endif
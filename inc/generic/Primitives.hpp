@@ -0,0 +1,41 @@
+
+#ifndef CS354_GENERIC_PRIMITIVES_HPP
+#define CS354_GENERIC_PRIMITIVES_HPP
+
+#include "../common.hpp"
+#include "Mesh.hpp"
+
+namespace cs354 {
+    /* Meshes of the GLUT shapes, with the same sizes, orientation and
+     * tessellation as the glutSolid and glutWire functions of the same
+     * name. Each shape is built once for every set of arguments, uploaded,
+     * and kept until Release(); after that drawing it is a single
+     * glDrawElements. Needs a current GL context.
+     *
+     * The returned meshes stay valid until Release(), and are drawn solid
+     * with drawTriangles() or as wireframes with drawLines().
+     */
+    class Primitives {
+    public:
+        /* Centered on the origin, poles on the z axis */
+        static Mesh & Sphere(GLfloat radius, int slices, int stacks);
+        /* Around the z axis, in the xy plane */
+        static Mesh & Torus(GLfloat inner, GLfloat outer, int sides,
+                            int rings);
+        /* Base on the xy plane, pointing up the z axis, with its base
+         * closed */
+        static Mesh & Cone(GLfloat base, GLfloat height, int slices,
+                           int stacks);
+        /* From the xy plane up the z axis, with both ends closed */
+        static Mesh & Cylinder(GLfloat radius, GLfloat height, int slices,
+                               int stacks);
+        /* Centered on the origin, edges along the axes */
+        static Mesh & Cube(GLfloat size);
+        
+        /* Releases and forgets every mesh, while the context they were
+         * uploaded in is current */
+        static void Release();
+    };
+}
+
+#endif
@@ -2,37 +2,83 @@
 #ifndef CS354_GENERIC_SHADER_HPP
 #define CS354_GENERIC_SHADER_HPP
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string>
 #include <vector>
 #include <exception>
 #include "../common.hpp"
 #include "Material.hpp"
+#include "SymbolTable.hpp"
 
 namespace cs354 {
+    /* Names of uniforms, interned once for every Shader. Code that sets a
+     * uniform every frame looks its id up once, and each Shader finds the
+     * location by indexing with it. */
+    typedef Symbol UniformId;
+    
     class Shader {
     public:
         /* Static interface */
         static void UseDefaultShaders();
+        /* The id of a uniform name; the same in every Shader. Ids can be
+         * taken before or after the Shaders using them are linked. */
+        static UniformId Uniform(const char *name);
         
         /* Non-static interface */
         Shader();
         ~Shader();
         
+        /* Shaders are compiled by link(); errors compiling them are thrown
+         * from there */
         void add(GLenum type, FILE *file);
         void add(GLenum type, std::string &progdata);
+        /* Keep linked programs in the given directory, as
+         * "<hash of the sources>.cache". A cached program is used if the
+         * sources and the GL driver are the same and the driver accepts
+         * it; otherwise the sources are compiled and the cache rewritten.
+         * Only used where the GL has program binaries. */
+        void useCache(const std::string &dir);
         void link();
         void use();
         
         /* Get opengl handle to shader. */
         GLuint handle();
-        /* Get uniform location from this shader */
+        /* Get uniform location from this shader. The active uniforms are
+         * listed once by link(); other names (such as elements of arrays)
+         * are asked of the GL. */
         GLint getUniform(const char *name);
+        GLint getUniform(UniformId id) const;
+        /* Set a uniform of this shader, which must be in use (see use());
+         * std::runtime_error is thrown if it isn't. They go through GLState,
+         * so setting a uniform to the value it already has sends nothing;
+         * uniforms set through these shouldn't also be set with glUniform*.
+         */
+        void setUniform1i(UniformId id, GLint x);
+        void setUniform1f(UniformId id, GLfloat x);
+        void setUniform3f(UniformId id, GLfloat x, GLfloat y, GLfloat z);
+        void setUniform4f(UniformId id, GLfloat x, GLfloat y, GLfloat z,
+                          GLfloat w);
         /* Get MaterialLocations. */
         const MaterialLocations & getLocations() const;
     private:
+        GLuint compile(GLenum type, const std::string &progdata);
+        /* Program binary cache, see useCache() */
+        uint64_t source_hash() const;
+        std::string cache_path() const;
+        bool load_binary();
+        bool save_binary();
+        void find_uniforms();
+        /* Throws unless this is the program in use */
+        void check_in_use() const;
+        
         MaterialLocations locations;
+        /* Locations, indexed by UniformId */
+        std::vector<GLint> uniforms;
         GLuint program;
+        std::vector<GLenum> types;
+        std::vector<std::string> sources;
+        std::string cacheDir;
         std::vector<GLuint> shaders;
         bool linked;
     };
@@ -0,0 +1,40 @@
+
+#ifndef CS354_GENERIC_STATIC_GEOMETRY_HPP
+#define CS354_GENERIC_STATIC_GEOMETRY_HPP
+
+#include "../common.hpp"
+#include "Mesh.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace cs354 {
+    /* Meshes of constant polygon tables, like the cube and cone arrays the
+     * display modes started with. The polygons are split into triangles
+     * when they're registered, keeping the per-vertex colors, and Upload()
+     * puts every mesh into buffer objects once there is a GL context. Each
+     * one is then drawn with drawTriangles() in a single call.
+     */
+    class StaticGeometry {
+    public:
+        /* Registers 'count' indices into the vertex and color triplets,
+         * making polygons of 'sides' vertices each, which are fanned into
+         * triangles. 'colors' may be NULL. Registering a name again
+         * replaces its mesh. The mesh stays valid until Release(). */
+        static Mesh & Register(const std::string &name,
+                               const GLfloat *vertices,
+                               const GLfloat *colors, size_t nvertices,
+                               const GLuint *indices, size_t count,
+                               int sides);
+        /* The mesh registered under the name, or NULL */
+        static Mesh * Get(const std::string &name);
+        
+        /* Uploads every mesh that isn't yet. Needs a current GL context. */
+        static void Upload();
+        /* Releases and forgets every mesh, while the context they were
+         * uploaded in is current */
+        static void Release();
+    };
+}
+
+#endif
@@ -0,0 +1,79 @@
+
+#ifndef CS354_GENERIC_SYMBOL_TABLE_HPP
+#define CS354_GENERIC_SYMBOL_TABLE_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cs354 {
+    /* An interned string: the same name always gets the same id from a
+     * table, so names compare as integers. Ids count up from zero. */
+    typedef uint32_t Symbol;
+    
+    /* Interns the names of objects, groups and materials. The loader fills
+     * one in while parsing and hands it to the Model it builds, so every
+     * name is stored once per model. Both tables below are open addressing
+     * hash tables with linear probing, like the ElementIndex.
+     */
+    class SymbolTable {
+    public:
+        static const Symbol None;
+        
+        SymbolTable();
+        ~SymbolTable();
+        
+        /* Returns the name's symbol, adding it if it's new */
+        Symbol intern(const char *str, size_t len);
+        Symbol intern(const std::string &str);
+        /* Returns None for names that were never interned */
+        Symbol find(const char *str, size_t len) const;
+        Symbol find(const std::string &str) const;
+        
+        const std::string & name(Symbol sym) const;
+        size_t size() const;
+        
+        void clear();
+        void swap(SymbolTable &other);
+    private:
+        size_t lookup(const char *str, size_t len, uint64_t hash) const;
+        void grow();
+        
+        /* Symbols, or None for empty slots */
+        std::vector<Symbol> slots;
+        size_t mask;
+        std::vector<std::string> names;
+        std::vector<uint64_t> hashes;
+    };
+    
+    /* Finds children by name: maps a parent's index and a symbol to the
+     * index of the child with that name. */
+    class SymbolIndex {
+    public:
+        SymbolIndex();
+        ~SymbolIndex();
+        
+        /* Returns the index stored for the pair, storing 'value' for it if
+         * there was none. 'inserted' is set to true if it was stored. */
+        uint32_t insert(uint32_t parent, Symbol sym, uint32_t value,
+                        bool &inserted);
+        /* Returns SymbolTable::None if nothing is stored for the pair */
+        uint32_t find(uint32_t parent, Symbol sym) const;
+        
+        void clear();
+        void swap(SymbolIndex &other);
+    private:
+        struct Slot {
+            uint64_t key; /*< Parent in the high word, symbol in the low */
+            uint32_t value; /*< None for empty slots */
+        };
+        
+        void grow();
+        
+        std::vector<Slot> slots;
+        size_t mask, count;
+    };
+}
+
+#endif
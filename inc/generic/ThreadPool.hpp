@@ -0,0 +1,71 @@
+
+#ifndef CS354_GENERIC_THREAD_POOL_HPP
+#define CS354_GENERIC_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <deque>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace cs354 {
+    /* A unit of work for the ThreadPool. Subclass and implement run(). */
+    class Task {
+    public:
+        virtual ~Task();
+        virtual void run() = 0;
+    };
+    
+    /* Fixed set of worker threads pulling Tasks off a shared queue.
+     * run() hands the pool a batch of tasks and blocks until all of them
+     * are done. The calling thread works on the queue while it waits, so it
+     * is safe to call run() from inside a running Task.
+     */
+    class ThreadPool {
+    public:
+        /* Static interface */
+        /* Number of online processors, at least 1 */
+        static unsigned int Cores();
+        /* Process-wide pool with one thread per core */
+        static ThreadPool & Global();
+        
+        /* Non-static interface */
+        ThreadPool(unsigned int nthreads);
+        ~ThreadPool();
+        
+        /* Run every task in the list, returning when all have finished. If
+         * any task throws, the first error is rethrown as a
+         * std::runtime_error once the batch is complete. */
+        void run(const std::vector<Task *> &tasks);
+        
+        /* Number of threads that can work on a batch, counting the caller */
+        unsigned int size() const;
+    private:
+        struct Batch {
+            size_t remaining;
+            bool failed;
+            std::string error;
+        };
+        struct Job {
+            Task *task;
+            Batch *batch;
+        };
+        
+        static void * Worker(void *pool);
+        
+        /* Not copyable */
+        ThreadPool(const ThreadPool &);
+        ThreadPool & operator=(const ThreadPool &);
+        
+        /* Run a job, called without the lock held */
+        void execute(Job &job);
+        
+        std::vector<pthread_t> threads;
+        std::deque<Job> jobs;
+        pthread_mutex_t lock;
+        pthread_cond_t work, done;
+        bool shutdown;
+    };
+}
+
+#endif
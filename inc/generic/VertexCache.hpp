@@ -0,0 +1,42 @@
+
+#ifndef CS354_GENERIC_VERTEX_CACHE_HPP
+#define CS354_GENERIC_VERTEX_CACHE_HPP
+
+#include "../common.hpp"
+
+#include <cstddef>
+
+namespace cs354 {
+    /* How well an index list uses the post-transform vertex cache */
+    struct CacheMetrics {
+        CacheMetrics();
+        
+        /* Average cache miss ratio: vertices transformed per triangle.
+         * 0.5 is the best possible on a large regular mesh, 3.0 the worst. */
+        double acmr;
+        /* Average transform to vertex ratio: vertices transformed per
+         * distinct vertex used. 1.0 is perfect. */
+        double atvr;
+    };
+    
+    /* Triangle reordering for the GPU's post-transform vertex cache, and a
+     * simulation of that cache to measure the result.
+     */
+    class VertexCache {
+    public:
+        /* Entries in the simulated FIFO cache, and in the LRU cache the
+         * optimizer plans for */
+        static const size_t Size;
+        
+        /* Simulates drawing the triangle list. Indices must be less than
+         * 'nvertices'. */
+        static CacheMetrics Measure(const GLuint *indices, size_t count,
+                                    size_t nvertices);
+        /* Reorders the triangles of the list in place so that they reuse
+         * recently transformed vertices, after Tom Forsyth's "Linear-Speed
+         * Vertex Cache Optimisation". Each triangle keeps its winding. */
+        static void Optimize(GLuint *indices, size_t count);
+    };
+}
+
+#endif
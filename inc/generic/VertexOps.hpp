@@ -0,0 +1,35 @@
+
+#ifndef CS354_GENERIC_VERTEX_OPS_HPP
+#define CS354_GENERIC_VERTEX_OPS_HPP
+
+#include "../common.hpp"
+
+#include <cstddef>
+
+namespace cs354 {
+    /* Axis aligned bounds. An empty box has min > max. */
+    struct BoundingBox {
+        BoundingBox();
+        
+        /* Grow to include the other box */
+        void add(const BoundingBox &other);
+        
+        GLfloat min[3], max[3];
+    };
+    
+    /* Whole-array operations on packed xyz vertex data. These work on blocks
+     * of four vertices at a time with SSE where it's available, and are
+     * split over the global ThreadPool for large arrays.
+     */
+    class VertexOps {
+    public:
+        /* Bounds of 'count' vertices */
+        static BoundingBox Bounds(const GLfloat *xyz, size_t count);
+        /* v' = (v + offset) * scale for each vertex, in place. If offset is
+         * NULL the vertices are only scaled. */
+        static void Transform(GLfloat *xyz, size_t count,
+                              const GLfloat offset[3], GLfloat scale);
+    };
+}
+
+#endif
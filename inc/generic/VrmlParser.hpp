@@ -0,0 +1,103 @@
+
+#ifndef CS354_GENERIC_VRML_PARSER_HPP
+#define CS354_GENERIC_VRML_PARSER_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace cs354 {
+    /* One IndexedFaceSet as it was read. The faces index the points and are
+     * each terminated by a -1, including the last. */
+    struct VrmlFaceSet {
+        VrmlFaceSet();
+        
+        std::string name;            /*< Nearest DEF name around it, if any */
+        std::vector<float> points;   /*< Triplet */
+        std::vector<int> coordIndex;
+        size_t faces;
+    };
+    
+    /* Streaming reader of the geometry in VRML 2.0 (.wrl) files, and the
+     * VRML 1.0 files that use the same field names. Only the Coordinate
+     * (or Coordinate3) points and the IndexedFaceSet coordIndex are read;
+     * every other node is walked through and its fields ignored.
+     * The file is read through a fixed size buffer, so apart from the face
+     * set being filled in the memory used doesn't depend on the file.
+     * Errors in the file are thrown as std::runtime_error.
+     */
+    class VrmlParser {
+    public:
+        VrmlParser();
+        ~VrmlParser();
+        
+        /* Returns false if the file could not be opened */
+        bool open(const char *fname);
+        void close();
+        
+        /* Reads up to the end of the next IndexedFaceSet with any faces and
+         * fills in 'set', returning false at the end of the file. The points
+         * are replaced whenever a Coordinate node is read, and otherwise
+         * left as they were; a face set without coordinates of its own uses
+         * the last ones read, the way VRML 1.0 shares a Coordinate3 between
+         * face sets. USE is not resolved. */
+        bool next(VrmlFaceSet &set);
+        
+        /* Line of the file the parser is on */
+        int line() const;
+        /* Bytes read from the file so far */
+        size_t bytesRead() const;
+    private:
+        /* Owns the file and its buffer, so it isn't copyable */
+        VrmlParser(const VrmlParser &other);
+        VrmlParser & operator=(const VrmlParser &other);
+        
+        enum TokenType {
+            TOKEN_END,
+            TOKEN_WORD,   /*< Names, keywords and numbers */
+            TOKEN_STRING,
+            TOKEN_OPEN_BRACE,
+            TOKEN_CLOSE_BRACE,
+            TOKEN_OPEN_BRACKET,
+            TOKEN_CLOSE_BRACKET
+        };
+        enum NodeType {
+            NODE_OTHER,
+            NODE_COORDINATE,
+            NODE_FACE_SET
+        };
+        /* A node being read, and its DEF name */
+        struct Node {
+            NodeType type;
+            std::string name;
+        };
+        
+        /* The next token, which is [token, pos) in the buffer until the
+         * following call. Only the end of a string is kept. */
+        TokenType scan();
+        /* Moves what's left of the buffer to its start and reads more after
+         * it. Returns false at the end of the file. */
+        bool refill();
+        void read_points(std::vector<float> &points);
+        void read_indices(std::vector<int> &indices, size_t &faces);
+        void finish_face_set(VrmlFaceSet &set);
+        void error(const char *what) const;
+        
+        FILE *fp;
+        std::vector<char> buffer;
+        const char *token, *pos, *end;
+        bool eof;
+        int lineno;
+        size_t consumed;
+        
+        /* The nodes around the parser, and the DEF name and node type named
+         * by the last words read */
+        std::vector<Node> nodes;
+        std::string defName;
+        bool hasDefName;
+        NodeType nextNode;
+    };
+}
+
+#endif
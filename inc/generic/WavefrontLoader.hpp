@@ -2,8 +2,9 @@
 #ifndef CS354_GENERIC_WAVEFRONT_LOADER_HPP
 #define CS354_GENERIC_WAVEFRONT_LOADER_HPP
 
-/* This loader will have trouble with very large models, but I don't plan on
- * loading several hundred megabyte models anyways.
+/* By default .obj files are mapped into memory and tokenized by hand, which
+ * is a good deal faster than the flex/bison parser on large models. The bison
+ * parser is still available, and is used for the material files.
  */
 
 #include <cstdio>
@@ -12,47 +13,75 @@
 #include <vector>
 
 #include "Geometry.hpp"
+#include "LoaderStats.hpp"
 #include "Material.hpp"
+#include "ModelCache.hpp"
+#include "SymbolTable.hpp"
+
+/* The most verbose loader messages built in; see WavefrontLoader::LogLevel.
+ * Anything above this is compiled out, which keeps per-face messages off the
+ * parsing path. Build with -DCS354_LOG_LEVEL=3 to get them back. */
+#ifndef CS354_LOG_LEVEL
+# define CS354_LOG_LEVEL 2
+#endif
 
 namespace cs354 {
     class Model;
+    class ModelFuture;
+    class ObjChunk;
     
+    /* The model as it's parsed. Objects, groups and material groups are
+     * kept in the order they're first seen, and refer to their children by
+     * index; names are symbols of the Loader's SymbolTable. */
     struct LoaderMatGroup {
         LoaderMatGroup();
-        LoaderMatGroup(const std::string &mtlname);
+        LoaderMatGroup(Symbol name);
         ~LoaderMatGroup();
         
-        std::string mtlname;
+        Symbol name; /*< The material's name */
         std::vector<Triangle> faces;
     };
     struct LoaderGroup {
         LoaderGroup();
-        LoaderGroup(const std::string &name);
+        LoaderGroup(Symbol name);
         ~LoaderGroup();
         
-        std::string name;
-        std::map<std::string, LoaderMatGroup> material_groups;
+        Symbol name;
+        std::vector<size_t> material_groups;
     };
     struct LoaderObject {
         LoaderObject();
-        LoaderObject(const std::string &name);
+        LoaderObject(Symbol name);
         ~LoaderObject();
         
-        std::string name;
-        std::map<std::string, LoaderGroup> groups;
+        Symbol name;
+        std::vector<size_t> groups;
     };
     
-    /* Biggest class in the project. As it supports both the wavefront object
-     * and wavefront material formats, this makes sense. Doesn't make it any
-     * easier to understand though. Essentially, the 'public' api consists of
+    /* Biggest class in the project. Material files are read by the shared
+     * MaterialLibrary, which still leaves the whole wavefront object format
+     * in here. Essentially, the 'public' api consists of
      * the top functions 'Model * load(const char *,...)' and
-     * 'void use(std::map<>&)'. Everything else is public for the bison
-     * generated parser to access through a global pointer to the current
-     * Loader. This makes the Loader impossible to thread, but that's not too
-     * important for this project. It could be fixed by using re-entrant
-     * parsers, but that's more work than I want to do right now. */
+     * 'void use(std::map<>&)'. Everything else is public for the parsers to
+     * access. The bison parsers are re-entrant and are handed the Loader they
+     * are filling in, so each Loader carries all of its own parse state and
+     * separate Loaders may be used on separate threads at the same time.
+     * A single Loader is not safe to share between threads. */
     class WavefrontLoader {
     public:
+        /* Which parser is used to read .obj files */
+        enum ParserType {
+            PARSER_MMAP,  /*< Hand-written tokenizer over a mapped file */
+            PARSER_BISON  /*< The flex/bison grammar in wavefront.y */
+        };
+        /* How much is written to the log */
+        enum LogLevel {
+            LOG_ERROR = 0, /*< Files that couldn't be loaded */
+            LOG_WARN  = 1, /*< Problems in files that could be worked around */
+            LOG_INFO  = 2, /*< Where models came from and their statistics */
+            LOG_DEBUG = 3  /*< Per-face messages */
+        };
+        
         WavefrontLoader(bool keep_materials = false,
                         bool global_mats = false);
         ~WavefrontLoader();
@@ -62,11 +91,40 @@ namespace cs354 {
         Model * load(const char *fname, Vertex origin);
         Model * load(const char *fname, GLfloat max_dim);
         Model * load(const char *fname, Vertex origin, GLfloat max_dim);
+        /* The same, but on a separate thread. The returned handle must be
+         * deleted by the caller, and this Loader can't be used again until
+         * the load has finished. */
+        ModelFuture * loadAsync(const char *fname);
+        ModelFuture * loadAsync(const char *fname, Vertex origin);
+        ModelFuture * loadAsync(const char *fname, GLfloat max_dim);
+        ModelFuture * loadAsync(const char *fname, Vertex origin,
+                                GLfloat max_dim);
         
         /* Set global Material table */
         void use(std::map<std::string, Material> & global_mat_map);
+        /* Select the .obj parser. If the file can't be mapped the bison
+         * parser is used regardless. */
+        void useParser(ParserType type);
+        /* Enable or disable the binary model cache (on by default). Loaders
+         * that keep materials between loads or add to a global material
+         * table never use the cache, as their results depend on more than
+         * the files read. */
+        void useCache(bool enable);
+        /* Reorder each material group's triangles for the GPU's vertex cache
+         * and renumber the vertices in the order they're first drawn (off by
+         * default). Optimized models are cached separately. */
+        void useOptimizer(bool enable);
+        /* Only log messages at or below the given level. The default is
+         * LOG_INFO; levels above CS354_LOG_LEVEL are never logged. */
+        void useLogLevel(LogLevel level);
+        
+        /* Timings and counts for the last load. Later phases done with the
+         * Model, such as uploading it, can be added with a PhaseTimer. */
+        LoaderStats & stats();
+        const LoaderStats & stats() const;
         
         /* Interface for adding things from the parser. */
+        void line(int lineno);
         void v(GLfloat coords[3]);
         void vn(GLfloat coords[3]);
         void vt(GLfloat coords[3]);
@@ -77,13 +135,6 @@ namespace cs354 {
         void g(const char *groupname);
         void o(const char *objectname);
         
-        void newmtl(const char *mtlname);
-        void ka(GLfloat color[3]);
-        void kd(GLfloat color[3]);
-        void ks(GLfloat color[3]);
-        void ns(GLfloat amount);
-        void tr(GLfloat amount);
-        
         /* Unsupported Features */
         void vp(GLfloat coord[3]);
         void map_ka(const char *kamap);
@@ -93,26 +144,50 @@ namespace cs354 {
         void bump(const char *bumpmap);
         void decal(const char *decal);
         void illum(int illval);
+        
+        friend class ModelFuture;
     private:
+        /* Shared by the load() overloads; applies the transforms named by
+         * the key and goes through the model cache. */
+        Model * load(const char *fname, const CacheKey &key);
         /* Helper function to clear out data */
         void parse(const char *fname);
+        void parse_bison(FILE *fp);
+        void parse_mmap(const char *begin, const char *end);
+        void parse_parallel(const char *begin, const char *end,
+                            size_t nchunks);
+        void merge_chunks(const std::vector<ObjChunk *> &chunks);
         Model * cache_to_model();
-        void scale(GLfloat maxdim);
-        void translate(Vertex origin);
+        /* Recenters and/or rescales the vertices as the key asks */
+        void transform(const CacheKey &key);
+        /* Vertex cache optimization, see useOptimizer() */
+        void optimize(Model *model);
         void clear();
-        void log(const char *msg, ...);
+        /* Fills in the Model sizes of the statistics, and logs them */
+        void count(const Model *model);
+        void log(LogLevel level, const char *msg, ...);
         void resolve(Element &e);
-        void newObject(const std::string &name);
-        void newGroup(const std::string &name);
-        void newMatGroup(const std::string &name);
+        void push_face();
+        void newObject(Symbol name);
+        void newGroup(Symbol name);
+        void newMatGroup(Symbol name);
         
         void push_element(const Element &e, Model *mptr);
         /* File information */
-        std::string fname, libname, basename;
+        std::string fname, basename;
         FILE *fp;
+        ParserType parserType;
+        bool cacheEnabled, optimizeEnabled;
+        /* Material libraries read for the current model */
+        std::vector<std::string> libraries;
+        /* Line of the file currently being parsed, for error messages */
+        int lineno;
         
         /* Logging file pointer */
         FILE *logFile;
+        LogLevel verbosity;
+        
+        LoaderStats loadStats;
         
         /* Loader cache */
         std::vector<Element> faceStack;
@@ -122,20 +197,22 @@ namespace cs354 {
         
         bool invalidate_texcoords, invalidate_normals;
         
-        /* Useful stats for calculating bounding box and centering transforms
-         */
-        struct {
-            GLfloat x, y, z;
-        } max, min;
-        
         /* The model as loaded from the .obj file. This isn't guaranteed to
-         * be valid */
-        std::map<std::string, LoaderObject> objects;
+         * be valid. Every name read is interned in the symbol table, which
+         * is handed on to the Model; the indices find an object by name, a
+         * group by its object and name, and a material group by its group
+         * and name. */
+        SymbolTable symbols;
+        std::vector<LoaderObject> objects;
+        std::vector<LoaderGroup> groups;
+        std::vector<LoaderMatGroup> matGroups;
+        SymbolIndex objectIndex, groupIndex, matGroupIndex;
         
         /* Material Maps. If the material named cannot be found in the local
-         * map, look in the global map.
+         * map, look in the global map. The local map points into the shared
+         * MaterialLibrary of each mtllib read.
          */
-        std::map<std::string, Material> materials;
+        std::map<std::string, const Material *> materials;
         std::map<std::string, Material> * globalMaterialMap;
         
         /* Look-ahead values for materials that are defined before starting a
@@ -145,16 +222,9 @@ namespace cs354 {
          */
         struct {
             bool hasMtl, hasGroup, hasObject;
-            std::string mtl, group, object;
+            Symbol mtl, group, object;
         } next;
         
-        /* Local Material buffer, used when reading material files */
-        struct {
-            bool valid;
-            std::string name;
-            Material def;
-        } mat;
-        
         /* Material behavior flags.
          * keepMaterials will cause the Loader to save materials between runs.
          * globalMaterials will cause the Loader to put materials into the
@@ -162,14 +232,11 @@ namespace cs354 {
          */
         bool keepMaterials, globalMaterials;
         
+        /* Indices of the entries faces are added to, set by the first face */
         struct {
-            LoaderMatGroup *mgroup;
-            LoaderGroup *group;
-            LoaderObject *object;
+            size_t mgroup, group, object;
         } current;
     };
-    
-    extern WavefrontLoader *loader;
 }
 
 #endif
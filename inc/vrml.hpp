@@ -2,19 +2,43 @@
 #define _VRML_H_
 
 #include "common.hpp"
+#include "generic/Mesh.hpp"
+#include "generic/VrmlParser.hpp"
 
 /* The current vermal object */
 namespace vrml {
     struct Object {
         Object(const char *name, int nv, GLfloat *vertices, int nf,
                GLint *faces);
+        /* Copies the face set, and frees the copy when destroyed */
+        Object(const cs354::VrmlFaceSet &set);
         ~Object();
         
+        /* Draws each face with its own glBegin(mode) */
         void draw(GLenum mode);
+        /* Draws the whole object with one glDrawElements, GL_POLYGON as
+         * triangles and GL_LINE_LOOP as its edges. The faces are converted
+         * and uploaded the first time, and an object with nothing to draw
+         * isn't converted again. */
+        void drawBuffered(GLenum mode);
+        /* Fans the faces into triangles and collects each edge they share
+         * once, into 'out' */
+        void triangulate(cs354::Mesh &out) const;
+        
         const char *name;
         int nVertices, nFaces;
         GLfloat *vertices;
         GLint *indices;
+        cs354::Mesh mesh;
+    private:
+        /* Objects may own their arrays, so they aren't copied */
+        Object(const Object &other);
+        Object & operator=(const Object &other);
+        
+        bool owned;
+        /* Set once drawBuffered has converted the faces, even if the mesh
+         * came out empty and was never uploaded */
+        bool converted;
     };
     
     Object & CurrentObject();
@@ -22,6 +46,11 @@ namespace vrml {
     void PrevObject();
     void SetObject(int num);
     int NumObjects();
+    /* Adds an object for every IndexedFaceSet in a VRML file, returning how
+     * many were added. Each is centered and scaled to the size of the built
+     * in objects. Errors in the file are thrown as std::runtime_error,
+     * after which the objects read before the error are kept. */
+    int Load(const char *fname);
 }
 
 #endif	/* _VRML_H_ */
@@ -0,0 +1,101 @@
+/**
+ * ElementIndex:
+ * Open addressing hash table used by the WavefrontLoader to collapse
+ * repeated v/vt/vn triples into a single model vertex.
+ */
+
+#include "generic/ElementIndex.hpp"
+
+using namespace cs354;
+
+static const size_t _min_capacity = 64;
+
+static inline uint64_t pack(const Element &e) {
+    return (uint64_t(uint32_t(e.v + 1)) |
+            (uint64_t(uint32_t(e.vt + 1)) << 32));
+}
+static inline size_t hash(uint64_t key, uint32_t vn) {
+    uint64_t h = key ^ (uint64_t(vn) * 0xC2B2AE3D27D4EB4FULL);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return size_t(h);
+}
+
+ElementIndex::ElementIndex(size_t expected) :
+    mask(0), count(0), nlookups(0), nprobes(0)
+{
+    /* Keep the table at most 3/4 full */
+    size_t capacity = _min_capacity;
+    while(capacity * 3 < expected * 4) {
+        capacity <<= 1;
+    }
+    Slot empty = { 0, 0, EMPTY };
+    slots.assign(capacity, empty);
+    mask = capacity - 1;
+}
+ElementIndex::~ElementIndex() { }
+
+GLuint ElementIndex::insert(const Element &e, GLuint next, bool &inserted) {
+    uint64_t key = pack(e);
+    uint32_t vn = uint32_t(e.vn + 1);
+    
+    nlookups += 1;
+    size_t pos = hash(key, vn) & mask;
+    for(;;) {
+        nprobes += 1;
+        Slot &slot = slots[pos];
+        if(slot.value == EMPTY) {
+            break;
+        }
+        if(slot.key == key && slot.vn == vn) {
+            inserted = false;
+            return slot.value;
+        }
+        pos = (pos + 1) & mask;
+    }
+    
+    inserted = true;
+    Slot &slot = slots[pos];
+    slot.key = key;
+    slot.vn = vn;
+    slot.value = next;
+    count += 1;
+    if(count * 4 > slots.size() * 3) {
+        grow();
+    }
+    return next;
+}
+
+size_t ElementIndex::size() const {
+    return count;
+}
+size_t ElementIndex::capacity() const {
+    return slots.size();
+}
+size_t ElementIndex::lookups() const {
+    return nlookups;
+}
+size_t ElementIndex::probes() const {
+    return nprobes;
+}
+
+void ElementIndex::grow() {
+    std::vector<Slot> old;
+    old.swap(slots);
+    
+    Slot empty = { 0, 0, EMPTY };
+    slots.assign(old.size() * 2, empty);
+    mask = slots.size() - 1;
+    
+    for(size_t i = 0; i < old.size(); ++i) {
+        if(old[i].value == EMPTY) {
+            continue;
+        }
+        size_t pos = hash(old[i].key, old[i].vn) & mask;
+        while(slots[pos].value != EMPTY) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = old[i];
+    }
+}
@@ -0,0 +1,439 @@
+/**
+ * GLState:
+ * A cache of the GL state the canvas sets every frame. Each setter compares
+ * against what was last set through it and only calls the GL on a change,
+ * counting the calls either way.
+ */
+
+#include "generic/GLState.hpp"
+
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+#ifdef __MAC__
+# include <OpenGL/glext.h>
+# define glBindVertexArray glBindVertexArrayAPPLE
+# define glDeleteVertexArrays glDeleteVertexArraysAPPLE
+#endif
+
+using namespace cs354;
+
+/* A single binding, which isn't known until it's set through GLState */
+struct Binding {
+    Binding() : known(false), value(0) { }
+    
+    bool known;
+    GLuint value;
+};
+struct RangeBinding {
+    RangeBinding() : known(false), buffer(0), offset(0), size(0) { }
+    
+    bool known;
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+/* State kept by a vertex array object: the element buffer, and which client
+ * arrays are enabled. Bits of 'known' are set for arrays in 'enabled' that
+ * are known. */
+struct ArrayState {
+    ArrayState() : known(0), enabled(0) { }
+    
+    Binding element;
+    unsigned known, enabled;
+};
+union UniformValue {
+    GLint i[4];
+    GLfloat f[4];
+};
+/* The last value set at a uniform location, once there is one */
+struct UniformSlot {
+    UniformSlot() : known(false) { }
+    
+    bool known;
+    UniformValue value;
+};
+/* A program's uniforms, indexed by location */
+typedef std::vector<UniformSlot> ProgramUniforms;
+
+static GLCounters _counters;
+
+static Binding _program, _array_buffer, _uniform_buffer, _texture;
+static std::vector<RangeBinding> _uniform_ranges;
+static Binding _vertex_array;
+/* The default vertex array object's state, and the bound one's, which is
+ * forgotten whenever another is bound */
+static ArrayState _default_arrays, _bound_arrays;
+static std::vector<std::pair<GLenum, bool> > _caps;
+static std::map<GLuint, ProgramUniforms> _uniforms;
+/* The uniforms of the program in use, found when it's bound, and NULL
+ * while that isn't known */
+static ProgramUniforms *_current_uniforms = NULL;
+
+/* Counts the call, and returns whether it has to be issued */
+static bool update(Binding &binding, GLuint value, GLCounters::Kind kind) {
+    bool issue = !binding.known || binding.value != value;
+    binding.known = true;
+    binding.value = value;
+    GLState::Count(kind, issue);
+    return issue;
+}
+
+static void forget(Binding &binding, GLuint value) {
+    if(binding.known && binding.value == value) {
+        binding.known = false;
+    }
+}
+
+static ArrayState & current_arrays() {
+    if(_vertex_array.known && _vertex_array.value == 0) {
+        return _default_arrays;
+    }
+    return _bound_arrays;
+}
+
+/* Bit of a client array in ArrayState, or 0 for those that aren't kept */
+static unsigned array_bit(GLenum array) {
+    switch(array) {
+    case GL_VERTEX_ARRAY:
+        return 1u << 0;
+    case GL_NORMAL_ARRAY:
+        return 1u << 1;
+    case GL_COLOR_ARRAY:
+        return 1u << 2;
+    case GL_TEXTURE_COORD_ARRAY:
+        return 1u << 3;
+    default:
+        return 0;
+    }
+}
+
+static bool update_array(GLenum array, bool enable) {
+    unsigned bit = array_bit(array);
+    ArrayState &arrays = current_arrays();
+    bool issue = (bit == 0 || (arrays.known & bit) == 0 ||
+                  ((arrays.enabled & bit) != 0) != enable);
+    arrays.known |= bit;
+    if(enable) {
+        arrays.enabled |= bit;
+    }else {
+        arrays.enabled &= ~bit;
+    }
+    GLState::Count(GLCounters::ARRAY, issue);
+    return issue;
+}
+
+static std::pair<GLenum, bool> * find_cap(GLenum cap) {
+    for(size_t i = 0; i < _caps.size(); ++i) {
+        if(_caps[i].first == cap) {
+            return &(_caps[i]);
+        }
+    }
+    return NULL;
+}
+
+static bool update_cap(GLenum cap, bool enable) {
+    std::pair<GLenum, bool> *known = find_cap(cap);
+    bool issue = (known == NULL || known->second != enable);
+    if(known == NULL) {
+        _caps.push_back(std::make_pair(cap, enable));
+    }else {
+        known->second = enable;
+    }
+    GLState::Count(GLCounters::CAPABILITY, issue);
+    return issue;
+}
+
+/* Counts the call, and returns whether the uniform has to be sent. Values
+ * are only kept while the program in use is known. */
+static bool update_uniform(GLint location, const UniformValue &value,
+                           size_t size)
+{
+    if(_current_uniforms == NULL) {
+        GLState::Count(GLCounters::UNIFORM, true);
+        return true;
+    }
+    ProgramUniforms &uniforms = *_current_uniforms;
+    if(size_t(location) >= uniforms.size()) {
+        uniforms.resize(size_t(location) + 1);
+    }
+    UniformSlot &slot = uniforms[size_t(location)];
+    bool issue = (!slot.known || memcmp(&(slot.value), &value, size) != 0);
+    if(issue) {
+        slot.known = true;
+        memcpy(&(slot.value), &value, size);
+    }
+    GLState::Count(GLCounters::UNIFORM, issue);
+    return issue;
+}
+
+/**************************************************/
+GLCounters::GLCounters() {
+    memset(issued, 0, sizeof(issued));
+    memset(filtered, 0, sizeof(filtered));
+}
+
+size_t GLCounters::totalIssued() const {
+    size_t total = 0;
+    for(size_t k = 0; k < KINDS; ++k) {
+        total += issued[k];
+    }
+    return total;
+}
+size_t GLCounters::totalFiltered() const {
+    size_t total = 0;
+    for(size_t k = 0; k < KINDS; ++k) {
+        total += filtered[k];
+    }
+    return total;
+}
+/**************************************************/
+
+/**************************************************/
+/* Static Interface */
+void GLState::UseProgram(GLuint program) {
+    if(update(_program, program, GLCounters::PROGRAM)) {
+        glUseProgram(program);
+        _current_uniforms = &(_uniforms[program]);
+    }
+}
+
+GLuint GLState::CurrentProgram() {
+    if(!_program.known) {
+        GLint program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        _program.known = true;
+        _program.value = GLuint(program);
+        _current_uniforms = &(_uniforms[_program.value]);
+    }
+    return _program.value;
+}
+
+void GLState::ForgetProgram(GLuint program) {
+    forget(_program, program);
+    if(!_program.known) {
+        _current_uniforms = NULL;
+    }
+    _uniforms.erase(program);
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer) {
+    Binding *binding = NULL;
+    switch(target) {
+    case GL_ARRAY_BUFFER:
+        binding = &_array_buffer;
+        break;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        binding = &(current_arrays().element);
+        break;
+    case GL_UNIFORM_BUFFER:
+        binding = &_uniform_buffer;
+        break;
+    default:
+        break;
+    }
+    if(binding == NULL) {
+        Count(GLCounters::BUFFER, true);
+        glBindBuffer(target, buffer);
+    }else if(update(*binding, buffer, GLCounters::BUFFER)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                              GLintptr offset, GLsizeiptr size)
+{
+    if(target != GL_UNIFORM_BUFFER) {
+        Count(GLCounters::BUFFER, true);
+        glBindBufferRange(target, index, buffer, offset, size);
+        return;
+    }
+    if(index >= _uniform_ranges.size()) {
+        _uniform_ranges.resize(index + 1);
+    }
+    RangeBinding &range = _uniform_ranges[index];
+    bool issue = (!range.known || range.buffer != buffer ||
+                  range.offset != offset || range.size != size);
+    Count(GLCounters::BUFFER, issue);
+    if(issue) {
+        glBindBufferRange(target, index, buffer, offset, size);
+        range.known = true;
+        range.buffer = buffer;
+        range.offset = offset;
+        range.size = size;
+        /* It binds the generic binding point as well */
+        _uniform_buffer.known = true;
+        _uniform_buffer.value = buffer;
+    }
+}
+
+void GLState::DeleteBuffers(GLsizei n, const GLuint *buffers) {
+    glDeleteBuffers(n, buffers);
+    /* Deleting a bound buffer binds 0 in its place, except in vertex array
+     * objects that aren't bound */
+    ArrayState &arrays = current_arrays();
+    for(GLsizei i = 0; i < n; ++i) {
+        GLuint buffer = buffers[i];
+        if(buffer == 0) {
+            continue;
+        }
+        forget(_array_buffer, buffer);
+        forget(_uniform_buffer, buffer);
+        forget(arrays.element, buffer);
+        forget(_default_arrays.element, buffer);
+        for(size_t r = 0; r < _uniform_ranges.size(); ++r) {
+            if(_uniform_ranges[r].buffer == buffer) {
+                _uniform_ranges[r].known = false;
+            }
+        }
+    }
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture) {
+    if(target != GL_TEXTURE_2D) {
+        Count(GLCounters::TEXTURE, true);
+        glBindTexture(target, texture);
+    }else if(update(_texture, texture, GLCounters::TEXTURE)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void GLState::DeleteTextures(GLsizei n, const GLuint *textures) {
+    glDeleteTextures(n, textures);
+    for(GLsizei i = 0; i < n; ++i) {
+        if(textures[i] != 0) {
+            forget(_texture, textures[i]);
+        }
+    }
+}
+
+void GLState::BindVertexArray(GLuint array) {
+    if(update(_vertex_array, array, GLCounters::ARRAY)) {
+        glBindVertexArray(array);
+        _bound_arrays = ArrayState();
+    }
+}
+
+void GLState::DeleteVertexArrays(GLsizei n, const GLuint *arrays) {
+    glDeleteVertexArrays(n, arrays);
+    for(GLsizei i = 0; i < n; ++i) {
+        /* The default object is bound in place of a deleted one */
+        if(arrays[i] != 0 && _vertex_array.known &&
+           _vertex_array.value == arrays[i])
+        {
+            _vertex_array.value = 0;
+        }
+    }
+}
+
+void GLState::EnableClientState(GLenum array) {
+    if(update_array(array, true)) {
+        glEnableClientState(array);
+    }
+}
+void GLState::DisableClientState(GLenum array) {
+    if(update_array(array, false)) {
+        glDisableClientState(array);
+    }
+}
+
+void GLState::Enable(GLenum cap) {
+    if(update_cap(cap, true)) {
+        glEnable(cap);
+    }
+}
+void GLState::Disable(GLenum cap) {
+    if(update_cap(cap, false)) {
+        glDisable(cap);
+    }
+}
+bool GLState::IsEnabled(GLenum cap) {
+    std::pair<GLenum, bool> *known = find_cap(cap);
+    if(known != NULL) {
+        return known->second;
+    }
+    bool enabled = (glIsEnabled(cap) == GL_TRUE);
+    _caps.push_back(std::make_pair(cap, enabled));
+    return enabled;
+}
+
+void GLState::Uniform1i(GLint location, GLint x) {
+    if(location == -1) {
+        return;
+    }
+    UniformValue value;
+    value.i[0] = x;
+    if(update_uniform(location, value, sizeof(GLint))) {
+        glUniform1i(location, x);
+    }
+}
+void GLState::Uniform1f(GLint location, GLfloat x) {
+    if(location == -1) {
+        return;
+    }
+    UniformValue value;
+    value.f[0] = x;
+    if(update_uniform(location, value, sizeof(GLfloat))) {
+        glUniform1f(location, x);
+    }
+}
+void GLState::Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) {
+    if(location == -1) {
+        return;
+    }
+    UniformValue value;
+    value.f[0] = x;
+    value.f[1] = y;
+    value.f[2] = z;
+    if(update_uniform(location, value, 3 * sizeof(GLfloat))) {
+        glUniform3f(location, x, y, z);
+    }
+}
+void GLState::Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z,
+                        GLfloat w)
+{
+    if(location == -1) {
+        return;
+    }
+    UniformValue value;
+    value.f[0] = x;
+    value.f[1] = y;
+    value.f[2] = z;
+    value.f[3] = w;
+    if(update_uniform(location, value, 4 * sizeof(GLfloat))) {
+        glUniform4f(location, x, y, z, w);
+    }
+}
+
+void GLState::Reset() {
+    _program = Binding();
+    _array_buffer = Binding();
+    _uniform_buffer = Binding();
+    _texture = Binding();
+    _uniform_ranges.clear();
+    _vertex_array = Binding();
+    _default_arrays = ArrayState();
+    _bound_arrays = ArrayState();
+    _caps.clear();
+    _uniforms.clear();
+    _current_uniforms = NULL;
+}
+
+void GLState::Count(GLCounters::Kind kind, bool issued) {
+    if(issued) {
+        _counters.issued[kind] += 1;
+    }else {
+        _counters.filtered[kind] += 1;
+    }
+}
+
+const GLCounters & GLState::Counters() {
+    return _counters;
+}
+
+void GLState::ResetCounters() {
+    _counters = GLCounters();
+}
+/**************************************************/
@@ -21,15 +21,18 @@ Element & Element::operator=(const Element &rhs) {
 bool Element::operator==(const Element &rhs) const {
     return (rhs.v == v && rhs.vt == vt && rhs.vn == vn);
 }
+/* Lexicographic on (v, vt, vn), so this is a proper strict weak ordering */
 bool Element::operator<(const Element &rhs) const {
-    return ((v != rhs.v && v < rhs.v) ||
-            (vt != rhs.vt && vt < rhs.vt) ||
-            (vn != rhs.vn && vn < rhs.vn));
+    if(v != rhs.v) {
+        return v < rhs.v;
+    }
+    if(vt != rhs.vt) {
+        return vt < rhs.vt;
+    }
+    return vn < rhs.vn;
 }
 bool Element::operator>(const Element &rhs) const {
-    return ((v != rhs.v && v > rhs.v) ||
-            (vt != rhs.vt && vt > rhs.vt) ||
-            (vn != rhs.vn && vn > rhs.vn));
+    return rhs < (*this);
 }
 bool Element::operator<=(const Element &rhs) const {
     return ((*this) == rhs || (*this) < rhs);
@@ -0,0 +1,211 @@
+/**
+ * LoaderStats:
+ * Per-phase timing and allocation counts for the model loader.
+ * Allocations are counted by replacing the global operator new, which is
+ * only built in with CS354_COUNT_ALLOCS. The counters are touched with
+ * atomic adds, but they're shared by every thread, so parse workers that
+ * allocate contend on them.
+ */
+
+#include "generic/LoaderStats.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <sys/time.h>
+#include <time.h>
+
+using namespace cs354;
+
+/**************************************************/
+/* Allocation counting */
+#if CS354_COUNT_ALLOCS
+#if __cplusplus >= 201103L
+# define NEW_THROWS
+# define NEW_NOTHROW noexcept
+#else
+# define NEW_THROWS throw(std::bad_alloc)
+# define NEW_NOTHROW throw()
+#endif
+
+static volatile uint64_t _allocations = 0;
+static volatile uint64_t _allocated_bytes = 0;
+
+static inline void * counted_alloc(size_t size) {
+    __sync_fetch_and_add(&_allocations, 1);
+    __sync_fetch_and_add(&_allocated_bytes, uint64_t(size));
+    return malloc(size == 0 ? 1 : size);
+}
+static void * counted_new(size_t size) {
+    void *ptr;
+    while((ptr = counted_alloc(size)) == NULL) {
+        std::new_handler handler = std::set_new_handler(NULL);
+        std::set_new_handler(handler);
+        if(handler == NULL) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    return ptr;
+}
+
+void * operator new(size_t size) NEW_THROWS {
+    return counted_new(size);
+}
+void * operator new[](size_t size) NEW_THROWS {
+    return counted_new(size);
+}
+void * operator new(size_t size, const std::nothrow_t &) NEW_NOTHROW {
+    return counted_alloc(size);
+}
+void * operator new[](size_t size, const std::nothrow_t &) NEW_NOTHROW {
+    return counted_alloc(size);
+}
+void operator delete(void *ptr) NEW_NOTHROW {
+    free(ptr);
+}
+void operator delete[](void *ptr) NEW_NOTHROW {
+    free(ptr);
+}
+void operator delete(void *ptr, const std::nothrow_t &) NEW_NOTHROW {
+    free(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) NEW_NOTHROW {
+    free(ptr);
+}
+#endif
+/**************************************************/
+
+/**************************************************/
+static const char * const _phase_names[LoaderStats::PHASE_COUNT] = {
+    "read",
+    "parse",
+    "resolve",
+    "transform",
+    "dedup",
+    "optimize",
+    "cache",
+    "upload"
+};
+
+/* Writes a JSON string, escaping what JSON requires */
+static void write_json_string(FILE *fp, const std::string &str) {
+    fputc('"', fp);
+    for(size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = (unsigned char)str[i];
+        if(c == '"' || c == '\\') {
+            fputc('\\', fp);
+            fputc(c, fp);
+        }else if(c < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned int)c);
+        }else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+/**************************************************/
+
+/**************************************************/
+/* Static Interface */
+const char * LoaderStats::PhaseName(Phase phase) {
+    if(phase < 0 || phase >= PHASE_COUNT) {
+        return "unknown";
+    }
+    return _phase_names[phase];
+}
+
+#if CS354_COUNT_ALLOCS
+uint64_t LoaderStats::Allocations() {
+    return __sync_fetch_and_add(&_allocations, 0);
+}
+uint64_t LoaderStats::AllocatedBytes() {
+    return __sync_fetch_and_add(&_allocated_bytes, 0);
+}
+#else
+uint64_t LoaderStats::Allocations() {
+    return 0;
+}
+uint64_t LoaderStats::AllocatedBytes() {
+    return 0;
+}
+#endif
+
+double LoaderStats::Now() {
+#ifdef __MAC__
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+/**************************************************/
+
+/**************************************************/
+PhaseStats::PhaseStats() :
+    seconds(0.0), allocations(0), bytes(0)
+{ }
+
+LoaderStats::LoaderStats() {
+    reset();
+}
+
+void LoaderStats::reset() {
+    file = "";
+    cached = false;
+    total = 0.0;
+    for(int i = 0; i < PHASE_COUNT; ++i) {
+        phases[i] = PhaseStats();
+    }
+    objects = groups = materials = 0;
+    vertices = normals = texcoords = triangles = 0;
+    corners = distinct = 0;
+    unoptimized = optimized = CacheMetrics();
+}
+
+void LoaderStats::writeJSON(FILE *fp) const {
+    fputs("{\n  \"file\": ", fp);
+    write_json_string(fp, file);
+    fprintf(fp, ",\n  \"cached\": %s,\n", (cached ? "true" : "false"));
+    fprintf(fp, "  \"total_ms\": %.3f,\n", total * 1e3);
+    
+    fputs("  \"phases\": {\n", fp);
+    for(int i = 0; i < PHASE_COUNT; ++i) {
+        const PhaseStats &phase = phases[i];
+        fprintf(fp, "    \"%s\": { \"ms\": %.3f, \"allocations\": %llu, "
+                "\"bytes\": %llu }%s\n", _phase_names[i], phase.seconds * 1e3,
+                (unsigned long long)phase.allocations,
+                (unsigned long long)phase.bytes,
+                (i + 1 < PHASE_COUNT ? "," : ""));
+    }
+    fputs("  },\n", fp);
+    
+    fprintf(fp, "  \"model\": { \"objects\": %llu, \"groups\": %llu, "
+            "\"materials\": %llu, \"vertices\": %llu, \"normals\": %llu, "
+            "\"texcoords\": %llu, \"triangles\": %llu },\n",
+            (unsigned long long)objects, (unsigned long long)groups,
+            (unsigned long long)materials, (unsigned long long)vertices,
+            (unsigned long long)normals, (unsigned long long)texcoords,
+            (unsigned long long)triangles);
+    fprintf(fp, "  \"dedup\": { \"corners\": %llu, \"distinct\": %llu },\n",
+            (unsigned long long)corners, (unsigned long long)distinct);
+    fprintf(fp, "  \"vertex_cache\": { \"acmr_before\": %.4f, "
+            "\"atvr_before\": %.4f, \"acmr_after\": %.4f, "
+            "\"atvr_after\": %.4f }\n", unoptimized.acmr, unoptimized.atvr,
+            optimized.acmr, optimized.atvr);
+    fputs("}\n", fp);
+}
+
+PhaseTimer::PhaseTimer(LoaderStats &stats, LoaderStats::Phase phase) :
+    target(stats.phases[phase]), start(LoaderStats::Now()),
+    allocations(LoaderStats::Allocations()),
+    bytes(LoaderStats::AllocatedBytes())
+{ }
+PhaseTimer::~PhaseTimer() {
+    target.seconds += LoaderStats::Now() - start;
+    target.allocations += LoaderStats::Allocations() - allocations;
+    target.bytes += LoaderStats::AllocatedBytes() - bytes;
+}
+/**************************************************/
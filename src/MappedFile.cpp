@@ -0,0 +1,81 @@
+/**
+ * MappedFile:
+ * Thin wrapper around mmap for read-only access to whole files. Empty files
+ * are valid, they just have no data.
+ */
+
+#include "generic/MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cs354;
+
+MappedFile::MappedFile() :
+    begin(NULL), length(0), mapped(false)
+{ }
+MappedFile::MappedFile(const char *fname) :
+    begin(NULL), length(0), mapped(false)
+{
+    open(fname);
+}
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char *fname) {
+    close();
+    
+    int fd = ::open(fname, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    
+    struct stat info;
+    if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    
+    length = size_t(info.st_size);
+    if(length > 0) {
+        void *addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr == MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        /* We only ever walk the file front to back */
+        madvise(addr, length, MADV_SEQUENTIAL);
+        begin = static_cast<const char *>(addr);
+    }
+    
+    /* The mapping stays valid after the descriptor is closed */
+    ::close(fd);
+    mapped = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if(begin != NULL) {
+        munmap(const_cast<char *>(begin), length);
+    }
+    begin = NULL;
+    length = 0;
+    mapped = false;
+}
+
+bool MappedFile::valid() const {
+    return mapped;
+}
+const char * MappedFile::data() const {
+    return begin;
+}
+const char * MappedFile::end() const {
+    return begin + length;
+}
+size_t MappedFile::size() const {
+    return length;
+}
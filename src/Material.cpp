@@ -1,6 +1,8 @@
 
 #include "generic/Material.hpp"
 
+#include "generic/GLState.hpp"
+#include "generic/MaterialTable.hpp"
 #include "generic/Shader.hpp"
 
 using namespace cs354;
@@ -41,12 +43,14 @@ Material & Material::operator=(const Material &rhs) {
 }
 
 void Material::bind() const {
-    if(MaterialLocations::Bound()) {
-        glUniform3f(MaterialLocations::Ka(), ka[0], ka[1], ka[2]);
-        glUniform3f(MaterialLocations::Kd(), kd[0], kd[1], kd[2]);
-        glUniform3f(MaterialLocations::Ks(), ks[0], ks[1], ks[2]);
-        glUniform1f(MaterialLocations::Tr(), tr);
-        glUniform1f(MaterialLocations::Ns(), ns);
+    if(MaterialLocations::Table()) {
+        MaterialTable::BindSingle(*this);
+    }else if(MaterialLocations::Bound()) {
+        GLState::Uniform3f(MaterialLocations::Ka(), ka[0], ka[1], ka[2]);
+        GLState::Uniform3f(MaterialLocations::Kd(), kd[0], kd[1], kd[2]);
+        GLState::Uniform3f(MaterialLocations::Ks(), ks[0], ks[1], ks[2]);
+        GLState::Uniform1f(MaterialLocations::Tr(), tr);
+        GLState::Uniform1f(MaterialLocations::Ns(), ns);
     }else {
         glColor3f(ka[0], kd[1], kd[2]);
     }
@@ -78,6 +82,19 @@ int MaterialLocations::Tr() {
 int MaterialLocations::Ns() {
     return current_locations->loc_ns;
 }
+bool MaterialLocations::Table() {
+    return current_locations->block != GL_INVALID_INDEX;
+}
+int MaterialLocations::Index() {
+    return current_locations->loc_index;
+}
+
+GLint MaterialLocations::QuantOffset() {
+    return current_locations->loc_quant_offset;
+}
+GLint MaterialLocations::QuantScale() {
+    return current_locations->loc_quant_scale;
+}
 
 void MaterialLocations::Bind(const Shader &shader) {
     current_locations = &(shader.getLocations());
@@ -93,6 +110,10 @@ MaterialLocations::MaterialLocations() :
     loc_kd(-1),
     loc_ks(-1),
     loc_tr(-1),
-    loc_ns(-1)
+    loc_ns(-1),
+    block(GL_INVALID_INDEX),
+    loc_index(-1),
+    loc_quant_offset(-1),
+    loc_quant_scale(-1)
 { }
 MaterialLocations::~MaterialLocations() { }
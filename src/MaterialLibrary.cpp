@@ -0,0 +1,253 @@
+/**
+ * MaterialLibrary:
+ * Process-wide table of parsed .mtl files. Many models tend to share one
+ * large material library, so each file is only read once; every later
+ * mtllib naming it gets the same immutable library back.
+ */
+
+#include "generic/MaterialLibrary.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <limits.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <sys/stat.h>
+
+using namespace cs354;
+
+/**************************************************/
+/* Symbols from the bison and flex generated material parser */
+extern int mat_parse(void *scanner, MaterialLibrary *library);
+extern int mat_lex_init(void **scanner);
+extern int mat_lex_destroy(void *scanner);
+extern void mat_set_in(FILE *fp, void *scanner);
+/**************************************************/
+/* Defines to make my life easier */
+#define RuntimeError(msg) std::runtime_error(std::string(msg))
+
+static const char _inv_mat_ref[] =
+    "Attempt to set %s without material reference.\n";
+/**************************************************/
+
+/**************************************************/
+/* The shared table. A library being parsed is marked as loading; anyone
+ * else asking for it waits for that instead of parsing it again. */
+struct LibraryStamp {
+    uint64_t size;
+    int64_t mtime, mtime_nsec;
+};
+struct LibraryEntry {
+    LibraryEntry() : library(NULL), loading(false) { }
+    
+    LibraryStamp stamp;
+    const MaterialLibrary *library;
+    bool loading;
+};
+
+static pthread_mutex_t _table_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _table_loaded = PTHREAD_COND_INITIALIZER;
+static std::map<std::string, LibraryEntry> _table;
+
+static bool stamp_file(const char *fname, LibraryStamp &stamp) {
+    struct stat info;
+    if(stat(fname, &info) != 0) {
+        return false;
+    }
+    stamp.size = uint64_t(info.st_size);
+    stamp.mtime = int64_t(info.st_mtime);
+#ifdef __MAC__
+    stamp.mtime_nsec = int64_t(info.st_mtimespec.tv_nsec);
+#else
+    stamp.mtime_nsec = int64_t(info.st_mtim.tv_nsec);
+#endif
+    return true;
+}
+static inline bool same_stamp(const LibraryStamp &a, const LibraryStamp &b) {
+    return a.size == b.size && a.mtime == b.mtime &&
+           a.mtime_nsec == b.mtime_nsec;
+}
+
+static bool canonical_path(const std::string &fname, std::string &path) {
+    char buff[PATH_MAX];
+    if(realpath(fname.c_str(), buff) == NULL) {
+        return false;
+    }
+    path = buff;
+    return true;
+}
+/**************************************************/
+
+/**************************************************/
+/* Static Interface */
+const MaterialLibrary * MaterialLibrary::Load(const std::string &fname) {
+    std::string path;
+    LibraryStamp stamp;
+    if(!canonical_path(fname, path) || !stamp_file(path.c_str(), stamp)) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&_table_lock);
+    LibraryEntry &entry = _table[path];
+    while(entry.loading) {
+        pthread_cond_wait(&_table_loaded, &_table_lock);
+    }
+    if(entry.library != NULL && same_stamp(entry.stamp, stamp)) {
+        const MaterialLibrary *library = entry.library;
+        pthread_mutex_unlock(&_table_lock);
+        return library;
+    }
+    entry.loading = true;
+    pthread_mutex_unlock(&_table_lock);
+    
+    /* Map entries don't move, so the reference is still good after this */
+    MaterialLibrary *library = new MaterialLibrary(path);
+    try {
+        library->parse();
+    }catch(...) {
+        delete library;
+        pthread_mutex_lock(&_table_lock);
+        entry.loading = false;
+        pthread_cond_broadcast(&_table_loaded);
+        pthread_mutex_unlock(&_table_lock);
+        throw;
+    }
+    
+    pthread_mutex_lock(&_table_lock);
+    entry.stamp = stamp;
+    entry.library = library;
+    entry.loading = false;
+    pthread_cond_broadcast(&_table_loaded);
+    pthread_mutex_unlock(&_table_lock);
+    return library;
+}
+/**************************************************/
+
+/**************************************************/
+MaterialLibrary::MaterialLibrary(const std::string &path) :
+    filename(path)
+{
+    mat.valid = false;
+}
+MaterialLibrary::~MaterialLibrary() { }
+
+const Material * MaterialLibrary::get(const std::string &name) const {
+    std::map<std::string, Material>::const_iterator iter = table.find(name);
+    if(iter == table.end()) {
+        return NULL;
+    }
+    return &(iter->second);
+}
+const std::map<std::string, Material> & MaterialLibrary::materials() const {
+    return table;
+}
+const std::string & MaterialLibrary::path() const {
+    return filename;
+}
+
+void MaterialLibrary::newmtl(const char *mtlname) {
+    flush();
+    
+    /* Set the new name, then make sure that the material hasn't already been
+     * defined. A redefinition carries on from the earlier one. */
+    mat.name = mtlname;
+    
+    std::map<std::string, Material>::iterator iter = table.find(mat.name);
+    if(iter != table.end()) {
+        fprintf(stderr, "Redefinition of material \"%s\" in %s\n", mtlname,
+                filename.c_str());
+        mat.def = iter->second;
+    }else {
+        mat.def = Material::Default;
+    }
+    mat.valid = true;
+}
+void MaterialLibrary::ka(GLfloat color[3]) {
+    if(mat.valid) {
+        mat.def.ka[0] = color[0];
+        mat.def.ka[1] = color[1];
+        mat.def.ka[2] = color[2];
+    }else {
+        fprintf(stderr, _inv_mat_ref, "Ka");
+    }
+}
+void MaterialLibrary::kd(GLfloat color[3]) {
+    if(mat.valid) {
+        mat.def.kd[0] = color[0];
+        mat.def.kd[1] = color[1];
+        mat.def.kd[2] = color[2];
+    }else {
+        fprintf(stderr, _inv_mat_ref, "Kd");
+    }
+}
+void MaterialLibrary::ks(GLfloat color[3]) {
+    if(mat.valid) {
+        mat.def.ks[0] = color[0];
+        mat.def.ks[1] = color[1];
+        mat.def.ks[2] = color[2];
+    }else {
+        fprintf(stderr, _inv_mat_ref, "Ks");
+    }
+}
+void MaterialLibrary::ns(GLfloat amount) {
+    if(mat.valid) {
+        mat.def.ns = amount;
+    }else {
+        fprintf(stderr, _inv_mat_ref, "Ns");
+    }
+}
+void MaterialLibrary::tr(GLfloat amount) {
+    if(mat.valid) {
+        mat.def.tr = amount;
+    }else {
+        fprintf(stderr, _inv_mat_ref, "Tr");
+    }
+}
+
+/* Private methods of MaterialLibrary */
+void MaterialLibrary::parse() {
+    FILE *fp = fopen(filename.c_str(), "r");
+    if(!fp) {
+        throw RuntimeError("Could not open " + filename);
+    }
+    
+    void *scanner;
+    if(mat_lex_init(&scanner) != 0) {
+        fclose(fp);
+        throw RuntimeError("Could not create material scanner");
+    }
+    mat_set_in(fp, scanner);
+    
+    int rval;
+    try {
+        rval = mat_parse(scanner, this);
+    }catch(...) {
+        mat_lex_destroy(scanner);
+        fclose(fp);
+        throw;
+    }
+    
+    mat_lex_destroy(scanner);
+    fclose(fp);
+    flush();
+    
+    switch(rval) {
+    case 0:
+        break;
+    case 1:
+        throw RuntimeError("Syntax Error");
+    case 2:
+        throw RuntimeError("Parser exhausted memory");
+    default:
+        throw RuntimeError("Unknown Error");
+    }
+}
+
+void MaterialLibrary::flush() {
+    if(mat.valid) {
+        table[mat.name] = mat.def;
+    }
+    mat.valid = false;
+}
+/**************************************************/
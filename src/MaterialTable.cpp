@@ -0,0 +1,186 @@
+/**
+ * MaterialTable:
+ * Uniform buffers of std140 material records. Each Model keeps its own
+ * table, built from its draw batches the first time it's drawn with a
+ * shader that reads one.
+ */
+
+#include "generic/MaterialTable.hpp"
+
+#include "generic/GLState.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace cs354;
+
+const GLuint MaterialTable::Binding = 0;
+const size_t MaterialTable::Size = 256;
+
+/* One entry of the Materials block. Under std140 each vec3 starts on a 16
+ * byte boundary, and a float after one fills out its last 4 bytes. */
+struct MaterialRecord {
+    GLfloat ka[3];
+    GLfloat tr;
+    GLfloat kd[3];
+    GLfloat pad;
+    GLfloat ks[3];
+    GLfloat ns;
+};
+typedef char _material_record_size[sizeof(MaterialRecord) == 48 ? 1 : -1];
+
+static MaterialRecord make_record(const Material &mat) {
+    MaterialRecord rec;
+    memcpy(rec.ka, mat.ka, sizeof(rec.ka));
+    memcpy(rec.kd, mat.kd, sizeof(rec.kd));
+    memcpy(rec.ks, mat.ks, sizeof(rec.ks));
+    rec.tr = mat.tr;
+    rec.ns = mat.ns;
+    rec.pad = 0.0f;
+    return rec;
+}
+
+static size_t gcd(size_t a, size_t b) {
+    while(b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* The table BindSingle() writes into, made on first use, and the material
+ * last written to it */
+static MaterialTable _single_table;
+static MaterialRecord _single_record;
+
+/**************************************************/
+/* Static Interface */
+bool MaterialTable::Supported() {
+#ifdef __MAC__
+    /* The legacy OS X context doesn't have uniform buffers */
+    return false;
+#else
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if(version != NULL) {
+        int major = atoi(version);
+        const char *dot = strchr(version, '.');
+        int minor = (dot == NULL ? 0 : atoi(dot + 1));
+        if(major > 3 || (major == 3 && minor >= 1)) {
+            return true;
+        }
+    }
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    return extensions != NULL &&
+           strstr(extensions, "GL_ARB_uniform_buffer_object") != NULL;
+#endif
+}
+
+void MaterialTable::Locate(GLuint program, MaterialLocations &locations) {
+    locations.block = GL_INVALID_INDEX;
+    locations.loc_index = -1;
+#ifndef __MAC__
+    if(!Supported()) {
+        return;
+    }
+    locations.block = glGetUniformBlockIndex(program, "Materials");
+    if(locations.block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, locations.block, Binding);
+        locations.loc_index = glGetUniformLocation(program, "MaterialIndex");
+    }
+#endif
+}
+
+void MaterialTable::BindSingle(const Material &mat) {
+    MaterialRecord rec = make_record(mat);
+    if(!_single_table.uploaded()) {
+        std::vector<const Material *> materials(1, &mat);
+        _single_table.upload(materials);
+        _single_record = rec;
+    }else if(memcmp(&rec, &_single_record, sizeof(rec)) != 0) {
+        GLState::BindBuffer(GL_UNIFORM_BUFFER, _single_table.buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(rec), &rec);
+        GLState::BindBuffer(GL_UNIFORM_BUFFER, 0);
+        _single_record = rec;
+    }
+    _single_table.bind();
+    _single_table.select(0);
+}
+/**************************************************/
+
+/**************************************************/
+/* Non-static Interface */
+MaterialTable::MaterialTable() :
+    buffer(0), step(1), window(0)
+{ }
+/* The buffer belongs to a GL context, which may be gone by now; owners
+ * release() it while it's current */
+MaterialTable::~MaterialTable() { }
+
+void MaterialTable::upload(const std::vector<const Material *> &materials) {
+    release();
+    
+    /* Window offsets have to be multiples of both the record size and the
+     * GL's alignment */
+    GLint align = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    if(align < 1) {
+        align = 1;
+    }
+    size_t record = sizeof(MaterialRecord);
+    step = size_t(align) / gcd(size_t(align), record);
+    if(step > Size) {
+        step = Size;
+    }
+    
+    size_t count = materials.size();
+    /* Padded past the last material so every window is backed by a full
+     * Size entries */
+    size_t last = (count == 0 ? 0 : ((count - 1) / step) * step);
+    size_t capacity = last + Size;
+    MaterialRecord unused = make_record(Material::Default);
+    std::vector<MaterialRecord> records(capacity, unused);
+    for(size_t i = 0; i < count; ++i) {
+        records[i] = make_record(*(materials[i]));
+    }
+    
+    glGenBuffers(1, &buffer);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, capacity * record, &(records[0]),
+                 GL_STATIC_DRAW);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, 0);
+    window = 0;
+}
+
+void MaterialTable::release() {
+    if(buffer != 0) {
+        GLState::DeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    window = 0;
+}
+
+bool MaterialTable::uploaded() const {
+    return buffer != 0;
+}
+
+void MaterialTable::bind() {
+    bind_window(0);
+}
+
+void MaterialTable::select(size_t index) {
+    if(index < window || index >= window + Size) {
+        bind_window((index / step) * step);
+    }
+    GLState::Uniform1i(MaterialLocations::Index(), GLint(index - window));
+}
+
+/* Private methods of MaterialTable */
+void MaterialTable::bind_window(size_t first) {
+    size_t record = sizeof(MaterialRecord);
+    GLState::BindBufferRange(GL_UNIFORM_BUFFER, Binding, buffer,
+                             GLintptr(first * record),
+                             GLsizeiptr(Size * record));
+    window = first;
+}
+/**************************************************/
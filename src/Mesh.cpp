@@ -0,0 +1,174 @@
+/**
+ * Mesh:
+ * Buffered, indexed geometry for the shapes the canvas builds itself. The
+ * vertex buffer interleaves each vertex's position, normal and color (those
+ * it has), and the index buffer holds the triangles followed by the lines.
+ */
+
+#include "generic/Mesh.hpp"
+
+#include "generic/GLState.hpp"
+
+#include <cstring>
+
+using namespace cs354;
+
+static inline const GLvoid * buffer_offset(GLintptr offset) {
+    return reinterpret_cast<const GLvoid *>(offset);
+}
+
+/**************************************************/
+Mesh::Mesh() :
+    vbo(0), ibo(0), stride(0), triangleCount(0), lineCount(0),
+    normalOffset(0), colorOffset(0), lineOffset(0)
+{ }
+/* The buffers belong to a GL context, which may be gone by now; owners
+ * release() them while it's current */
+Mesh::~Mesh() { }
+
+void Mesh::clear() {
+    vertices.clear();
+    normals.clear();
+    colors.clear();
+    triangles.clear();
+    lines.clear();
+}
+
+void Mesh::upload() {
+    release();
+    if(vertices.empty()) {
+        return;
+    }
+    
+    /* Positions, then normals and colors if there's one for every vertex */
+    size_t count = vertices.size() / 3;
+    size_t floats = 3;
+    normalOffset = colorOffset = 0;
+    if(normals.size() == vertices.size()) {
+        normalOffset = GLintptr(floats * sizeof(GLfloat));
+        floats += 3;
+    }
+    if(colors.size() == vertices.size()) {
+        colorOffset = GLintptr(floats * sizeof(GLfloat));
+        floats += 3;
+    }
+    stride = GLsizei(floats * sizeof(GLfloat));
+    std::vector<GLfloat> interleaved(count * floats);
+    for(size_t v = 0; v < count; ++v) {
+        GLfloat *dest = &(interleaved[v * floats]);
+        memcpy(dest, &(vertices[v * 3]), 3 * sizeof(GLfloat));
+        dest += 3;
+        if(normalOffset != 0) {
+            memcpy(dest, &(normals[v * 3]), 3 * sizeof(GLfloat));
+            dest += 3;
+        }
+        if(colorOffset != 0) {
+            memcpy(dest, &(colors[v * 3]), 3 * sizeof(GLfloat));
+        }
+    }
+    glGenBuffers(1, &vbo);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, interleaved.size() * sizeof(GLfloat),
+                 interleaved.data(), GL_STATIC_DRAW);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    triangleCount = GLsizei(triangles.size());
+    lineCount = GLsizei(lines.size());
+    lineOffset = GLintptr(triangles.size() * sizeof(GLuint));
+    GLsizeiptr size = GLsizeiptr((triangles.size() + lines.size()) *
+                                 sizeof(GLuint));
+    glGenBuffers(1, &ibo);
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+    if(!triangles.empty()) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, lineOffset,
+                        triangles.data());
+    }
+    if(!lines.empty()) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, lineOffset,
+                        GLsizeiptr(lines.size() * sizeof(GLuint)),
+                        lines.data());
+    }
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::release() {
+    if(vbo != 0) {
+        GLState::DeleteBuffers(1, &vbo);
+    }
+    if(ibo != 0) {
+        GLState::DeleteBuffers(1, &ibo);
+    }
+    vbo = ibo = 0;
+    stride = 0;
+    triangleCount = lineCount = 0;
+    normalOffset = colorOffset = lineOffset = 0;
+}
+
+bool Mesh::uploaded() const {
+    return vbo != 0;
+}
+
+void Mesh::drawTriangles() {
+    draw(GL_TRIANGLES, triangles, triangleCount, 0);
+}
+
+void Mesh::drawLines() {
+    draw(GL_LINES, lines, lineCount, lineOffset);
+}
+
+/* Private methods of Mesh */
+void Mesh::draw(GLenum mode, const std::vector<GLuint> &indices,
+                GLsizei count, GLintptr offset)
+{
+    if(vbo == 0 && (vertices.empty() || indices.empty())) {
+        return;
+    }
+    if(vbo != 0 && count == 0) {
+        return;
+    }
+    
+    bool draws_normals = (vbo != 0 ? normalOffset != 0 :
+                          normals.size() == vertices.size());
+    bool draws_colors = (vbo != 0 ? colorOffset != 0 :
+                         colors.size() == vertices.size());
+    GLState::EnableClientState(GL_VERTEX_ARRAY);
+    if(draws_normals) {
+        GLState::EnableClientState(GL_NORMAL_ARRAY);
+    }
+    if(draws_colors) {
+        GLState::EnableClientState(GL_COLOR_ARRAY);
+    }
+    if(vbo != 0) {
+        GLState::BindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexPointer(3, GL_FLOAT, stride, buffer_offset(0));
+        if(draws_normals) {
+            glNormalPointer(GL_FLOAT, stride, buffer_offset(normalOffset));
+        }
+        if(draws_colors) {
+            glColorPointer(3, GL_FLOAT, stride, buffer_offset(colorOffset));
+        }
+        GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glDrawElements(mode, count, GL_UNSIGNED_INT, buffer_offset(offset));
+        GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }else {
+        glVertexPointer(3, GL_FLOAT, 0, vertices.data());
+        if(draws_normals) {
+            glNormalPointer(GL_FLOAT, 0, normals.data());
+        }
+        if(draws_colors) {
+            glColorPointer(3, GL_FLOAT, 0, colors.data());
+        }
+        glDrawElements(mode, GLsizei(indices.size()), GL_UNSIGNED_INT,
+                       indices.data());
+    }
+    if(draws_colors) {
+        GLState::DisableClientState(GL_COLOR_ARRAY);
+    }
+    if(draws_normals) {
+        GLState::DisableClientState(GL_NORMAL_ARRAY);
+    }
+    GLState::DisableClientState(GL_VERTEX_ARRAY);
+}
+/**************************************************/
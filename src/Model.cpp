@@ -1,137 +1,660 @@
 
 #include "generic/Model.hpp"
+#include "generic/GLState.hpp"
+#include "generic/VertexOps.hpp"
 
 #include <cstdio>
 #include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef __MAC__
+# include <OpenGL/glext.h>
+/* Vertex array objects come from the Apple extension on OS X */
+# define glGenVertexArrays glGenVertexArraysAPPLE
+# define VAO_EXTENSION "GL_APPLE_vertex_array_object"
+#else
+# define VAO_EXTENSION "GL_ARB_vertex_array_object"
+#endif
 
 using namespace cs354;
 
-MaterialGroup::MaterialGroup(const std::string &name, const Material &mat) :
-    name(name), mat(mat)
-{ }
-MaterialGroup::~MaterialGroup() { }
+/* Vertex array objects are core in 3.0 and an extension before that */
+static bool has_vertex_array_objects() {
+#ifndef __MAC__
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if(version != NULL && atoi(version) >= 3) {
+        return true;
+    }
+#endif
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    return extensions != NULL && strstr(extensions, VAO_EXTENSION) != NULL;
+}
 
-Group::Group(const std::string &name, const Model *owner) :
-    name(name), owner(owner)
-{ }
-Group::~Group() { }
+/* The compact format needs half float texture coordinates in the vertex
+ * arrays, which came with 3.0 */
+static bool has_compact_types() {
+#ifndef __MAC__
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if(version != NULL && atoi(version) >= 3) {
+        return true;
+    }
+#endif
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    return extensions != NULL &&
+           strstr(extensions, "GL_ARB_half_float_vertex") != NULL;
+}
+
+/* One interleaved vertex of the compact format. Positions are 16 bit fixed
+ * point across the model's bounding box. Normals are signed normalized
+ * shorts, which glNormalPointer scales back to [-1, 1] by itself. */
+struct CompactVertex {
+    GLshort position[3];
+    GLshort normal[3];
+    GLushort texture[2];
+};
+typedef char _compact_vertex_size[sizeof(CompactVertex) == 16 ? 1 : -1];
 
-MaterialGroup & Group::get(const char *name) {
-    return this->get(std::string(name));
+static const GLfloat _short_max = 32767.0f;
+
+static inline GLshort quantize(GLfloat value) {
+    value = (value > 1.0f ? 1.0f : (value < -1.0f ? -1.0f : value));
+    return GLshort(floorf(value * _short_max + 0.5f));
 }
-MaterialGroup & Group::get(const std::string &name) {
-    std::list<MaterialGroup>::iterator iter = matgroups.begin();
-    for(; iter != matgroups.end(); ++iter) {
-        if((*iter).name.compare(name) == 0) {
-            return *iter;
+
+/* IEEE half precision, rounded to nearest even */
+static GLushort float_to_half(GLfloat value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t absbits = bits & 0x7FFFFFFF;
+    
+    if(absbits >= 0x7F800000) {
+        /* Infinity stays infinity, NaNs stay NaNs */
+        return GLushort(sign | 0x7C00 | (absbits > 0x7F800000 ? 0x200 : 0));
+    }
+    if(absbits >= 0x477FF000) {
+        /* Rounds up past the largest half */
+        return GLushort(sign | 0x7C00);
+    }
+    if(absbits < 0x38800000) {
+        /* Subnormal half; shift the implicit one in and round */
+        if(absbits < 0x33000000) {
+            return GLushort(sign);
         }
+        uint32_t mant = (absbits & 0x7FFFFF) | 0x800000;
+        int shift = 126 - int(absbits >> 23);
+        uint32_t half = mant >> shift;
+        uint32_t rest = mant & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if(rest > midpoint || (rest == midpoint && (half & 1))) {
+            half += 1;
+        }
+        return GLushort(sign | half);
     }
     
-    const Material *mat = owner->getMaterial(name);
-    if(mat == NULL) {
-        fprintf(stderr, "Warning: Invalid material reference: %s\n",
-                name.c_str());
-        mat = &(Material::Default);
+    uint32_t half = ((absbits - 0x38000000) >> 13);
+    uint32_t rest = absbits & 0x1FFF;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half += 1;
     }
-    matgroups.push_back(MaterialGroup(name, *mat));
-    return matgroups.back();
+    return GLushort(sign | half);
+}
+
+/* Offsets into a bound buffer object are passed in place of pointers */
+static inline const GLvoid * buffer_offset(GLintptr offset) {
+    return reinterpret_cast<const GLvoid *>(offset);
+}
+
+DrawBatch::DrawBatch(const Material *mat) :
+    mat(mat)
+{ }
+DrawBatch::~DrawBatch() { }
+
+DrawCounters::DrawCounters() :
+    draws(0), binds(0), groups(0)
+{ }
+
+static const size_t _none = ~size_t(0);
+
+MaterialGroup::MaterialGroup() :
+    model(NULL), index(_none)
+{ }
+MaterialGroup::MaterialGroup(const Model *model, size_t index) :
+    model(model), index(index)
+{ }
+
+bool MaterialGroup::valid() const {
+    return model != NULL && index != _none;
+}
+const std::string & MaterialGroup::name() const {
+    return model->symbols.name(model->ranges[index].name);
+}
+const Material & MaterialGroup::material() const {
+    return *(model->ranges[index].mat);
+}
+const GLuint * MaterialGroup::elements() const {
+    const ModelRange &range = model->ranges[index];
+    return (range.count == 0 ? NULL : &(model->elements[range.first]));
+}
+size_t MaterialGroup::size() const {
+    return model->ranges[index].count;
 }
 
-Object::Object(const std::string &name, const Model *owner) :
-    name(name), owner(owner)
+Group::Group() :
+    model(NULL), index(_none)
+{ }
+Group::Group(const Model *model, size_t index) :
+    model(model), index(index)
 { }
-Object::~Object() { }
 
-Group & Object::get(const char *name) {
-    return this->get(std::string(name));
+bool Group::valid() const {
+    return model != NULL && index != _none;
 }
-Group & Object::get(const std::string &name) {
-    std::list<Group>::iterator iter = groups.begin();
-    for(; iter != groups.end(); ++iter) {
-        if((*iter).name.compare(name) == 0) {
-            return *iter;
-        }
+const std::string & Group::name() const {
+    return model->symbols.name(model->groups[index].name);
+}
+size_t Group::size() const {
+    return model->groups[index].count;
+}
+MaterialGroup Group::at(size_t i) const {
+    return MaterialGroup(model, model->groups[index].first + i);
+}
+MaterialGroup Group::get(const char *name) const {
+    return this->get(model->symbols.find(name, std::strlen(name)));
+}
+MaterialGroup Group::get(const std::string &name) const {
+    return this->get(model->symbols.find(name));
+}
+MaterialGroup Group::get(Symbol name) const {
+    uint32_t i = model->rangeIndex.find(uint32_t(index), name);
+    if(i == SymbolTable::None) {
+        return MaterialGroup();
     }
-    groups.push_back(Group(name, owner));
-    return groups.back();
+    return MaterialGroup(model, i);
 }
 
+Object::Object() :
+    model(NULL), index(_none)
+{ }
+Object::Object(const Model *model, size_t index) :
+    model(model), index(index)
+{ }
 
-Model::Model() { }
-Model::~Model() { }
+bool Object::valid() const {
+    return model != NULL && index != _none;
+}
+const std::string & Object::name() const {
+    return model->symbols.name(model->objects[index].name);
+}
+size_t Object::size() const {
+    return model->objects[index].count;
+}
+Group Object::at(size_t i) const {
+    return Group(model, model->objects[index].first + i);
+}
+Group Object::get(const char *name) const {
+    return this->get(model->symbols.find(name, std::strlen(name)));
+}
+Group Object::get(const std::string &name) const {
+    return this->get(model->symbols.find(name));
+}
+Group Object::get(Symbol name) const {
+    uint32_t i = model->groupIndex.find(uint32_t(index), name);
+    if(i == SymbolTable::None) {
+        return Group();
+    }
+    return Group(model, i);
+}
 
-Object & Model::get(const std::string &name) {
-    std::list<Object>::iterator iter = objects.begin();
-    for(; iter != objects.end(); ++iter) {
-        if((*iter).name.compare(name) == 0) {
-            return *iter;
+
+Model::Model() :
+    vbo(0), ibo(0), vao(0), vertexFormat(FORMAT_FLOAT), normalOffset(0),
+    textureOffset(0), quantScale(1.0f), batched(false)
+{
+    quantOffset[0] = quantOffset[1] = quantOffset[2] = 0.0f;
+}
+Model::~Model() {
+    release();
+}
+
+size_t Model::size() const {
+    return objects.size();
+}
+Object Model::at(size_t i) const {
+    return Object(this, i);
+}
+Object Model::get(const std::string &name) const {
+    return this->get(symbols.find(name));
+}
+Object Model::get(const char *name) const {
+    return this->get(symbols.find(name, std::strlen(name)));
+}
+Object Model::get(Symbol name) const {
+    uint32_t i = objectIndex.find(0, name);
+    if(i == SymbolTable::None) {
+        return Object();
+    }
+    return Object(this, i);
+}
+const SymbolTable & Model::names() const {
+    return symbols;
+}
+
+void Model::upload(VertexFormat format) {
+    release();
+    if(vertices.empty()) {
+        return;
+    }
+    
+    if(format == FORMAT_COMPACT && !has_compact_types()) {
+        fprintf(stderr, "Warning: compact vertices aren't supported by this "
+                "GL; uploading floats\n");
+        format = FORMAT_FLOAT;
+    }
+    vertexFormat = format;
+    
+    glGenBuffers(1, &vbo);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, vbo);
+    if(format == FORMAT_COMPACT) {
+        upload_compact();
+    }else {
+        upload_float();
+    }
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    /* The index buffer holds the elements batch by batch, so each batch is
+     * one range of it */
+    if(!batched) {
+        batch_groups();
+    }
+    std::vector<GLuint> sorted;
+    sorted.reserve(elements.size());
+    for(size_t b = 0; b < batches.size(); ++b) {
+        std::vector<size_t> &members = batches[b].ranges;
+        for(size_t r = 0; r < members.size(); ++r) {
+            const ModelRange &range = ranges[members[r]];
+            sorted.insert(sorted.end(), elements.begin() + range.first,
+                          elements.begin() + range.first + range.count);
         }
     }
-    objects.push_back(Object(name, this));
-    return objects.back();
+    
+    glGenBuffers(1, &ibo);
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sorted.size() * sizeof(GLuint),
+                 sorted.data(), GL_STATIC_DRAW);
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    batch_ranges();
+    
+    /* A vertex array object remembers the array setup, including the index
+     * buffer, so draw() only has to bind it. */
+    if(has_vertex_array_objects()) {
+        glGenVertexArrays(1, &vao);
+        GLState::BindVertexArray(vao);
+        bind_arrays();
+        GLState::BindVertexArray(0);
+    }
+}
+
+void Model::release() {
+    if(vao != 0) {
+        GLState::DeleteVertexArrays(1, &vao);
+    }
+    if(vbo != 0) {
+        GLState::DeleteBuffers(1, &vbo);
+    }
+    if(ibo != 0) {
+        GLState::DeleteBuffers(1, &ibo);
+    }
+    vbo = ibo = vao = 0;
+    materialTable.release();
+    if(batched) {
+        batch_ranges();
+    }
 }
-Object & Model::get(const char *name) {
-    return this->get(std::string(name));
+
+bool Model::uploaded() const {
+    return vbo != 0;
+}
+
+BoundingBox Model::bounds() const {
+    return VertexOps::Bounds(vertices.data(), vertices.size() / 3);
 }
 
 void Model::draw() {
-    size_t vsize = vertices.size();
-    /* Enable arrays only for what we will use. */
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, vertices.data());
-    bool do_norm = (normals.size() == vsize);
-    bool do_tex = (texture.size() == vsize);
-    if(do_norm) {
-        glEnableClientState(GL_NORMAL_ARRAY);
-        glNormalPointer(GL_FLOAT, 0, normals.data());
-    }
-    if(do_tex) {
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-        glTexCoordPointer(3,GL_FLOAT,0,texture.data());
+    /* Compact positions are turned back into model space by the shader,
+     * which leaves the modelview matrix the same as for float positions.
+     * Without a shader that does (the fixed function pipeline), the
+     * modelview matrix does it instead; the scale is the same on every
+     * axis, so normals only need rescaling. */
+    bool compact = (vbo != 0 && vertexFormat == FORMAT_COMPACT);
+    bool in_shader = (compact && MaterialLocations::QuantScale() != -1);
+    bool dequantize = (compact && !in_shader);
+    bool rescale = false;
+    if(in_shader) {
+        GLState::Uniform3f(MaterialLocations::QuantOffset(), quantOffset[0],
+                           quantOffset[1], quantOffset[2]);
+        GLState::Uniform1f(MaterialLocations::QuantScale(), quantScale);
+    }
+    if(dequantize) {
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glTranslatef(quantOffset[0], quantOffset[1], quantOffset[2]);
+        glScalef(quantScale, quantScale, quantScale);
+        rescale = GLState::IsEnabled(GL_RESCALE_NORMAL);
+        GLState::Enable(GL_RESCALE_NORMAL);
     }
     
-    /* Iterate over every group and sub-group, drawing them */
-    std::list<Object>::iterator obj_iter, obj_end = objects.end();
-    std::list<Group>::iterator group_iter, group_end;
-    std::list<MaterialGroup>::iterator mat_iter, mat_end;
-    for(obj_iter = objects.begin(); obj_iter != obj_end; ++obj_iter) {
-        Object &object = *obj_iter;
-        group_end = object.groups.end();
-        group_iter = object.groups.begin();
-        for(; group_iter != group_end; ++group_iter) {
-            Group &group = *group_iter;
-            mat_end = group.matgroups.end();
-            mat_iter = group.matgroups.begin();
-            for(; mat_iter != mat_end; ++mat_iter) {
-                MaterialGroup &mgroup = *mat_iter;
-                mgroup.mat.bind();
-                glDrawElements(GL_TRIANGLES, mgroup.elements.size(),
-                               GL_UNSIGNED_INT, &(mgroup.elements[0]));
-            }
+    if(vao != 0) {
+        GLState::BindVertexArray(vao);
+    }else {
+        bind_arrays();
+    }
+    
+    if(!batched) {
+        batch_groups();
+        batch_ranges();
+    }
+    bool table = MaterialLocations::Table();
+    if(table) {
+        if(!materialTable.uploaded()) {
+            upload_materials();
+        }
+        materialTable.bind();
+    }
+    for(size_t b = 0; b < batches.size(); ++b) {
+        DrawBatch &batch = batches[b];
+        if(table) {
+            materialTable.select(b);
+        }else {
+            batch.mat->bind();
+        }
+        if(batch.indices.size() == 1) {
+            glDrawElements(GL_TRIANGLES, batch.counts[0], GL_UNSIGNED_INT,
+                           batch.indices[0]);
+        }else {
+            glMultiDrawElements(GL_TRIANGLES, &(batch.counts[0]),
+                                GL_UNSIGNED_INT, &(batch.indices[0]),
+                                GLsizei(batch.indices.size()));
         }
     }
     
-    /* Disable any used arrays. */
-    if(do_tex) {
-        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    if(vao != 0) {
+        GLState::BindVertexArray(0);
+    }else {
+        unbind_arrays();
     }
-    if(do_norm) {
-        glDisableClientState(GL_NORMAL_ARRAY);
+    
+    if(in_shader) {
+        GLState::Uniform3f(MaterialLocations::QuantOffset(), 0.0f, 0.0f,
+                           0.0f);
+        GLState::Uniform1f(MaterialLocations::QuantScale(), 1.0f);
+    }
+    if(dequantize) {
+        if(!rescale) {
+            GLState::Disable(GL_RESCALE_NORMAL);
+        }
+        glPopMatrix();
+    }
+}
+
+const DrawCounters & Model::drawCounters() {
+    if(!batched) {
+        batch_groups();
+        batch_ranges();
     }
-    glDisable(GL_VERTEX_ARRAY);
+    return counters;
 }
 
 const Material * Model::getMaterial(const std::string &name) const {
     /* Names like this are why the 'auto' keyword was introduced
      * Find the material in our material map.
      */
-    std::map<std::string, Material>::const_iterator mat_loc;
+    std::map<std::string, const Material *>::const_iterator mat_loc;
     mat_loc = materials.find(name);
     if(mat_loc == materials.end()) {
         return NULL;
     }
-    /* Dereference the iterator, get a refernce. Take address of referenced
-     * object.
-     */
-    return &(mat_loc->second);
+    /* The map only holds pointers into the shared material libraries */
+    return mat_loc->second;
+}
+
+/* Protected methods of Model */
+void Model::add_object(Symbol name) {
+    ModelObject object;
+    object.name = name;
+    object.first = uint32_t(groups.size());
+    object.count = 0;
+    bool inserted;
+    objectIndex.insert(0, name, uint32_t(objects.size()), inserted);
+    objects.push_back(object);
+}
+void Model::add_group(Symbol name) {
+    ModelGroup group;
+    group.name = name;
+    group.object = uint32_t(objects.size() - 1);
+    group.first = uint32_t(ranges.size());
+    group.count = 0;
+    bool inserted;
+    groupIndex.insert(group.object, name, uint32_t(groups.size()), inserted);
+    groups.push_back(group);
+    objects.back().count++;
+}
+void Model::add_range(Symbol material, GLuint first, GLuint count) {
+    ModelRange range;
+    range.name = material;
+    range.object = uint32_t(objects.size() - 1);
+    range.group = uint32_t(groups.size() - 1);
+    range.mat = getMaterial(symbols.name(material));
+    if(range.mat == NULL) {
+        fprintf(stderr, "Warning: Invalid material reference: %s\n",
+                symbols.name(material).c_str());
+        range.mat = &(Material::Default);
+    }
+    range.first = first;
+    range.count = count;
+    bool inserted;
+    rangeIndex.insert(range.group, material, uint32_t(ranges.size()),
+                      inserted);
+    ranges.push_back(range);
+    groups.back().count++;
+}
+
+/* Private methods of Model */
+bool Model::draws_normals() const {
+    return !normals.empty() && normals.size() == vertices.size();
+}
+bool Model::draws_texture() const {
+    return !texture.empty() && texture.size() / 2 == vertices.size() / 3;
+}
+
+void Model::upload_float() {
+    /* Vertices, normals and texture coordinates go in one buffer, back to
+     * back */
+    GLsizeiptr vbytes = vertices.size() * sizeof(GLfloat);
+    GLsizeiptr nbytes = (draws_normals() ? normals.size() * sizeof(GLfloat) :
+                         0);
+    GLsizeiptr tbytes = (draws_texture() ? texture.size() * sizeof(GLfloat) :
+                         0);
+    normalOffset = vbytes;
+    textureOffset = vbytes + nbytes;
+    
+    glBufferData(GL_ARRAY_BUFFER, vbytes + nbytes + tbytes, NULL,
+                 GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vbytes, vertices.data());
+    if(nbytes > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, normalOffset, nbytes, normals.data());
+    }
+    if(tbytes > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, textureOffset, tbytes,
+                        texture.data());
+    }
+}
+
+void Model::upload_compact() {
+    /* Positions are stored relative to the center of the bounding box, in
+     * units of its longest half side */
+    BoundingBox box = bounds();
+    GLfloat extent = 0.0f;
+    for(int c = 0; c < 3; ++c) {
+        quantOffset[c] = (box.max[c] + box.min[c]) * 0.5f;
+        GLfloat half = (box.max[c] - box.min[c]) * 0.5f;
+        extent = (half > extent ? half : extent);
+    }
+    if(!(extent > 0.0f)) {
+        extent = 1.0f;
+    }
+    quantScale = extent / _short_max;
+    
+    size_t nvertices = vertices.size() / 3;
+    bool do_norm = draws_normals(), do_tex = draws_texture();
+    std::vector<CompactVertex> packed(nvertices);
+    for(size_t i = 0; i < nvertices; ++i) {
+        CompactVertex &out = packed[i];
+        for(int c = 0; c < 3; ++c) {
+            out.position[c] = quantize((vertices[i * 3 + c] - quantOffset[c]) /
+                                       extent);
+            out.normal[c] = (do_norm ? quantize(normals[i * 3 + c]) : 0);
+        }
+        out.texture[0] = (do_tex ? float_to_half(texture[i * 2]) : 0);
+        out.texture[1] = (do_tex ? float_to_half(texture[i * 2 + 1]) : 0);
+    }
+    
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(CompactVertex),
+                 packed.data(), GL_STATIC_DRAW);
+}
+
+void Model::batch_groups() {
+    batches.clear();
+    counters = DrawCounters();
+    std::map<const Material *, size_t> batch_of;
+    for(size_t r = 0; r < ranges.size(); ++r) {
+        if(ranges[r].count == 0) {
+            continue;
+        }
+        const Material *mat = ranges[r].mat;
+        std::map<const Material *, size_t>::iterator found;
+        found = batch_of.find(mat);
+        size_t index;
+        if(found == batch_of.end()) {
+            index = batches.size();
+            batch_of[mat] = index;
+            batches.push_back(DrawBatch(mat));
+        }else {
+            index = found->second;
+        }
+        batches[index].ranges.push_back(r);
+        counters.groups++;
+    }
+    counters.binds = batches.size();
+    batched = true;
+}
+
+void Model::batch_ranges() {
+    /* Batches are laid out one after another in the index buffer */
+    GLintptr offset = 0;
+    counters.draws = 0;
+    for(size_t b = 0; b < batches.size(); ++b) {
+        DrawBatch &batch = batches[b];
+        batch.indices.clear();
+        batch.counts.clear();
+        if(ibo != 0) {
+            GLsizei count = 0;
+            for(size_t r = 0; r < batch.ranges.size(); ++r) {
+                count += GLsizei(ranges[batch.ranges[r]].count);
+            }
+            batch.indices.push_back(buffer_offset(offset));
+            batch.counts.push_back(count);
+            offset += count * sizeof(GLuint);
+        }else {
+            /* Ranges that follow on from the last one in the element array
+             * just lengthen it */
+            GLuint end = 0;
+            for(size_t r = 0; r < batch.ranges.size(); ++r) {
+                const ModelRange &range = ranges[batch.ranges[r]];
+                if(!batch.counts.empty() && range.first == end) {
+                    batch.counts.back() += GLsizei(range.count);
+                }else {
+                    batch.indices.push_back(&(elements[range.first]));
+                    batch.counts.push_back(GLsizei(range.count));
+                }
+                end = range.first + range.count;
+            }
+        }
+        counters.draws += 1;
+    }
+}
+
+void Model::upload_materials() {
+    std::vector<const Material *> table(batches.size());
+    for(size_t b = 0; b < batches.size(); ++b) {
+        table[b] = batches[b].mat;
+    }
+    materialTable.upload(table);
+}
+
+void Model::bind_arrays() {
+    /* Enable arrays only for what we will use. */
+    if(vbo != 0 && vertexFormat == FORMAT_COMPACT) {
+        bind_compact_arrays();
+        return;
+    }
+    GLState::EnableClientState(GL_VERTEX_ARRAY);
+    if(vbo != 0) {
+        GLState::BindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexPointer(3, GL_FLOAT, 0, buffer_offset(0));
+    }else {
+        glVertexPointer(3, GL_FLOAT, 0, vertices.data());
+    }
+    if(draws_normals()) {
+        GLState::EnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, (vbo != 0 ?
+            buffer_offset(normalOffset) : normals.data()));
+    }
+    if(draws_texture()) {
+        GLState::EnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, 0, (vbo != 0 ?
+            buffer_offset(textureOffset) : texture.data()));
+    }
+    if(vbo != 0) {
+        GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    }
+}
+
+void Model::bind_compact_arrays() {
+    GLsizei stride = sizeof(CompactVertex);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, vbo);
+    GLState::EnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_SHORT, stride,
+                    buffer_offset(offsetof(CompactVertex, position)));
+    if(draws_normals()) {
+        GLState::EnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_SHORT, stride,
+                        buffer_offset(offsetof(CompactVertex, normal)));
+    }
+    if(draws_texture()) {
+        GLState::EnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_HALF_FLOAT, stride,
+                          buffer_offset(offsetof(CompactVertex, texture)));
+    }
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+}
+
+void Model::unbind_arrays() {
+    /* Disable any used arrays. */
+    if(draws_texture()) {
+        GLState::DisableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+    if(draws_normals()) {
+        GLState::DisableClientState(GL_NORMAL_ARRAY);
+    }
+    GLState::DisableClientState(GL_VERTEX_ARRAY);
+    if(ibo != 0) {
+        GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
 }
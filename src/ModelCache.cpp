@@ -0,0 +1,613 @@
+/**
+ * ModelCache:
+ * Binary snapshots of loaded Models, so large .obj files only have to be
+ * parsed once. See ModelCache.hpp for what is stored and when it's used.
+ */
+
+#include "generic/ModelCache.hpp"
+#include "generic/MappedFile.hpp"
+#include "generic/MaterialLibrary.hpp"
+#include "generic/Model.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cs354;
+
+/**************************************************/
+/* On-disk layout. Everything is written in native byte order; a cache from
+ * a machine with a different byte order is simply rejected. */
+const uint32_t ModelCache::Version = 1;
+
+static const char _cache_magic[8] = { 'C','S','3','5','4','M','C','\0' };
+static const uint32_t _cache_byteorder = 0x01020304;
+static const uint64_t _cache_missing = ~uint64_t(0);
+static const size_t _cache_align = 8;
+
+enum CacheSectionId {
+    SECTION_VERTICES,
+    SECTION_NORMALS,
+    SECTION_TEXTURE,
+    SECTION_INDICES,
+    SECTION_OBJECTS,
+    SECTION_GROUPS,
+    SECTION_MATGROUPS,
+    SECTION_MATERIALS,
+    SECTION_DEPENDS,
+    SECTION_STRINGS,
+    SECTION_COUNT
+};
+
+struct CacheStamp {
+    uint64_t size;
+    int64_t mtime, mtime_nsec;
+};
+struct CacheSection {
+    uint64_t offset, count;
+};
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    CacheStamp source;
+    uint64_t hash;
+    uint32_t flags;
+    GLfloat origin[3];
+    GLfloat max_dim;
+    uint32_t reserved;
+    CacheSection sections[SECTION_COUNT];
+};
+
+struct CacheName {
+    uint32_t offset, length;
+};
+/* Objects index into the group table, groups into the material group table
+ * and material groups into the index array. */
+struct CacheRange {
+    CacheName name;
+    uint64_t first, count;
+};
+struct CacheMaterial {
+    CacheName name;
+    GLfloat ka[3], kd[3], ks[3];
+    GLfloat tr, ns;
+    int32_t illum;
+};
+struct CacheDepend {
+    CacheName path;
+    CacheStamp stamp;
+};
+
+/* Record sizes, indexed by section */
+static const size_t _section_size[SECTION_COUNT] = {
+    sizeof(GLfloat),
+    sizeof(GLfloat),
+    sizeof(GLfloat),
+    sizeof(GLuint),
+    sizeof(CacheRange),
+    sizeof(CacheRange),
+    sizeof(CacheRange),
+    sizeof(CacheMaterial),
+    sizeof(CacheDepend),
+    sizeof(char)
+};
+/**************************************************/
+
+/**************************************************/
+/* Helpers */
+static inline size_t align_up(size_t n) {
+    return (n + _cache_align - 1) & ~(_cache_align - 1);
+}
+
+/* Returns false if the file doesn't exist. */
+static bool stamp_file(const char *fname, CacheStamp &stamp) {
+    struct stat info;
+    if(stat(fname, &info) != 0) {
+        stamp.size = _cache_missing;
+        stamp.mtime = stamp.mtime_nsec = 0;
+        return false;
+    }
+    stamp.size = uint64_t(info.st_size);
+    stamp.mtime = int64_t(info.st_mtime);
+#ifdef __MAC__
+    stamp.mtime_nsec = int64_t(info.st_mtimespec.tv_nsec);
+#else
+    stamp.mtime_nsec = int64_t(info.st_mtim.tv_nsec);
+#endif
+    return true;
+}
+static inline bool same_stamp(const CacheStamp &a, const CacheStamp &b) {
+    return a.size == b.size && a.mtime == b.mtime &&
+           a.mtime_nsec == b.mtime_nsec;
+}
+
+static bool hash_file(const char *fname, uint64_t &hash) {
+    MappedFile file;
+    if(!file.open(fname)) {
+        return false;
+    }
+    hash = ModelCache::Hash(file.data(), file.size());
+    return true;
+}
+
+/* Rewrites the source stamp in a cache's header, after a source whose
+ * modification time changed turned out to have the same contents. A torn
+ * write only means the next load hashes the source again. */
+static void restamp_cache(const std::string &path, const CacheStamp &stamp) {
+    int fd = open(path.c_str(), O_WRONLY);
+    if(fd < 0) {
+        return;
+    }
+    ssize_t wrote = pwrite(fd, &stamp, sizeof(stamp),
+                           off_t(offsetof(CacheHeader, source)));
+    (void)wrote;
+    close(fd);
+}
+
+/* Adds the materials of a library to 'shared', later libraries replacing
+ * earlier definitions like they do in the loader. */
+static bool add_library(const std::string &fname,
+                        std::map<std::string, const Material *> &shared)
+{
+    typedef std::map<std::string, Material>::const_iterator lib_iter;
+    const MaterialLibrary *library;
+    try {
+        library = MaterialLibrary::Load(fname);
+    }catch(...) {
+        return false;
+    }
+    if(library == NULL) {
+        return false;
+    }
+    const std::map<std::string, Material> &defs = library->materials();
+    for(lib_iter iter = defs.begin(); iter != defs.end(); ++iter) {
+        shared[iter->first] = &(iter->second);
+    }
+    return true;
+}
+static bool same_material(const CacheMaterial &rec, const Material &mat) {
+    return memcmp(rec.ka, mat.ka, sizeof(rec.ka)) == 0 &&
+           memcmp(rec.kd, mat.kd, sizeof(rec.kd)) == 0 &&
+           memcmp(rec.ks, mat.ks, sizeof(rec.ks)) == 0 &&
+           memcmp(&rec.tr, &mat.tr, sizeof(rec.tr)) == 0 &&
+           memcmp(&rec.ns, &mat.ns, sizeof(rec.ns)) == 0 &&
+           rec.illum == mat.illum;
+}
+
+/* Collects names for the strings section. A Model's names are symbols, so
+ * each is written once however many entries share it. */
+class StringTable {
+public:
+    CacheName add(const std::string &str) {
+        CacheName name = { uint32_t(data.size()), uint32_t(str.size()) };
+        data.insert(data.end(), str.begin(), str.end());
+        return name;
+    }
+    CacheName add(const SymbolTable &symbols, Symbol sym) {
+        if(written.size() < symbols.size()) {
+            CacheName none = { 0, _no_name };
+            written.resize(symbols.size(), none);
+        }
+        if(written[sym].length == _no_name) {
+            written[sym] = add(symbols.name(sym));
+        }
+        return written[sym];
+    }
+    
+    std::vector<char> data;
+private:
+    static const uint32_t _no_name = 0xFFFFFFFFu;
+    std::vector<CacheName> written;
+};
+
+/* Bounds checked view of a mapped cache file */
+class CacheView {
+public:
+    CacheView(const MappedFile &file, const CacheHeader &header) :
+        file(file), header(header)
+    { }
+    
+    /* Returns NULL if the section doesn't fit in the file */
+    template <typename T>
+    const T * section(CacheSectionId id) const {
+        const CacheSection &sec = header.sections[id];
+        if(sec.offset % _cache_align != 0 || sec.offset > file.size()) {
+            return NULL;
+        }
+        if(sec.count > (file.size() - sec.offset) / _section_size[id]) {
+            return NULL;
+        }
+        return reinterpret_cast<const T *>(file.data() + sec.offset);
+    }
+    size_t count(CacheSectionId id) const {
+        return size_t(header.sections[id].count);
+    }
+    
+    bool name(const CacheName &name, std::string &out) const {
+        const char *strings = section<char>(SECTION_STRINGS);
+        size_t nstrings = count(SECTION_STRINGS);
+        if(strings == NULL || name.offset > nstrings ||
+           name.length > nstrings - name.offset)
+        {
+            return false;
+        }
+        out.assign(strings + name.offset, name.length);
+        return true;
+    }
+    bool range(const CacheRange &range, size_t limit) const {
+        return range.first <= limit && range.count <= limit - range.first;
+    }
+private:
+    const MappedFile &file;
+    const CacheHeader &header;
+};
+
+/* Pads a section of the given size out to the alignment boundary */
+static bool write_padding(FILE *fp, size_t bytes) {
+    static const char padding[_cache_align] = { 0 };
+    size_t pad = align_up(bytes) - bytes;
+    return pad == 0 || fwrite(padding, 1, pad, fp) == pad;
+}
+static bool write_section(FILE *fp, const void *data, size_t bytes) {
+    if(bytes > 0 && fwrite(data, 1, bytes, fp) != bytes) {
+        return false;
+    }
+    return write_padding(fp, bytes);
+}
+/**************************************************/
+
+/**************************************************/
+CacheKey::CacheKey() :
+    flags(0), max_dim(0.0f)
+{
+    origin[0] = origin[1] = origin[2] = 0.0f;
+}
+
+std::string ModelCache::Path(const char *source) {
+    return std::string(source) + ".cache";
+}
+
+uint64_t ModelCache::Hash(const char *data, size_t len) {
+    static const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    
+    /* Whole words first, then the odd bytes at the end */
+    size_t nwords = len / sizeof(uint64_t);
+    for(size_t i = 0; i < nwords; ++i) {
+        uint64_t word;
+        memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+        hash ^= word;
+        hash *= prime;
+    }
+    for(size_t i = nwords * sizeof(uint64_t); i < len; ++i) {
+        hash ^= uint64_t((unsigned char)data[i]);
+        hash *= prime;
+    }
+    return hash;
+}
+
+Model * ModelCache::Load(const char *source, const CacheKey &key) {
+    CacheStamp stamp;
+    if(!stamp_file(source, stamp)) {
+        return NULL;
+    }
+    
+    MappedFile file;
+    if(!file.open(Path(source).c_str()) || file.size() < sizeof(CacheHeader)) {
+        return NULL;
+    }
+    
+    /* The mapping is page aligned, so the header can be used in place */
+    const CacheHeader &header =
+        *reinterpret_cast<const CacheHeader *>(file.data());
+    if(memcmp(header.magic, _cache_magic, sizeof(_cache_magic)) != 0 ||
+       header.version != Version || header.byteorder != _cache_byteorder)
+    {
+        return NULL;
+    }
+    
+    /* Must have been loaded the same way */
+    if(header.flags != key.flags) {
+        return NULL;
+    }
+    if((key.flags & TRANSLATED) && (header.origin[0] != key.origin[0] ||
+       header.origin[1] != key.origin[1] || header.origin[2] != key.origin[2]))
+    {
+        return NULL;
+    }
+    if((key.flags & SCALED) && header.max_dim != key.max_dim) {
+        return NULL;
+    }
+    
+    /* Check the source file, only hashing it if the cheap check fails */
+    if(header.source.size != stamp.size) {
+        return NULL;
+    }
+    bool restamp = false;
+    if(!same_stamp(header.source, stamp)) {
+        uint64_t hash;
+        if(!hash_file(source, hash) || hash != header.hash) {
+            return NULL;
+        }
+        restamp = true;
+    }
+    
+    CacheView view(file, header);
+    const GLfloat *vertices = view.section<GLfloat>(SECTION_VERTICES);
+    const GLfloat *normals = view.section<GLfloat>(SECTION_NORMALS);
+    const GLfloat *texture = view.section<GLfloat>(SECTION_TEXTURE);
+    const GLuint *indices = view.section<GLuint>(SECTION_INDICES);
+    const CacheRange *objects = view.section<CacheRange>(SECTION_OBJECTS);
+    const CacheRange *groups = view.section<CacheRange>(SECTION_GROUPS);
+    const CacheRange *mgroups = view.section<CacheRange>(SECTION_MATGROUPS);
+    const CacheMaterial *materials =
+        view.section<CacheMaterial>(SECTION_MATERIALS);
+    const CacheDepend *depends = view.section<CacheDepend>(SECTION_DEPENDS);
+    if(vertices == NULL || normals == NULL || texture == NULL ||
+       indices == NULL || objects == NULL || groups == NULL ||
+       mgroups == NULL || materials == NULL || depends == NULL ||
+       view.section<char>(SECTION_STRINGS) == NULL)
+    {
+        return NULL;
+    }
+    
+    /* Material libraries must not have changed (or appeared) either. The
+     * materials themselves come from the shared libraries, in the same order
+     * the loader read them. */
+    std::string name;
+    CacheStamp dep_stamp;
+    std::map<std::string, const Material *> shared;
+    for(size_t i = 0; i < view.count(SECTION_DEPENDS); ++i) {
+        if(!view.name(depends[i].path, name)) {
+            return NULL;
+        }
+        stamp_file(name.c_str(), dep_stamp);
+        if(!same_stamp(depends[i].stamp, dep_stamp)) {
+            return NULL;
+        }
+        if(dep_stamp.size != _cache_missing && !add_library(name, shared)) {
+            return NULL;
+        }
+    }
+    
+    /* Check the tables before building anything. The file may have been
+     * damaged or edited, so the arrays have to agree with each other too:
+     * normals and texture coordinates are either missing or one for every
+     * vertex, and the indices are checked as they're copied. */
+    size_t nobjects = view.count(SECTION_OBJECTS);
+    size_t ngroups = view.count(SECTION_GROUPS);
+    size_t nmgroups = view.count(SECTION_MATGROUPS);
+    size_t nindices = view.count(SECTION_INDICES);
+    size_t nfloats = view.count(SECTION_VERTICES);
+    size_t nnormals = view.count(SECTION_NORMALS);
+    size_t ntexture = view.count(SECTION_TEXTURE);
+    if(nfloats % 3 != 0 || (nnormals != 0 && nnormals != nfloats) ||
+       (ntexture != 0 && ntexture != nfloats / 3 * 2))
+    {
+        return NULL;
+    }
+    for(size_t i = 0; i < nobjects; ++i) {
+        if(!view.range(objects[i], ngroups)) {
+            return NULL;
+        }
+    }
+    for(size_t i = 0; i < ngroups; ++i) {
+        if(!view.range(groups[i], nmgroups)) {
+            return NULL;
+        }
+    }
+    for(size_t i = 0; i < nmgroups; ++i) {
+        if(!view.range(mgroups[i], nindices)) {
+            return NULL;
+        }
+    }
+    
+    Model *model = new Model();
+    
+    /* Materials go in first, material groups look them up by name. The
+     * records have to agree with the libraries. */
+    for(size_t i = 0; i < view.count(SECTION_MATERIALS); ++i) {
+        const CacheMaterial &rec = materials[i];
+        std::map<std::string, const Material *>::const_iterator mat;
+        if(!view.name(rec.name, name) ||
+           (mat = shared.find(name)) == shared.end() ||
+           !same_material(rec, *(mat->second)))
+        {
+            delete model;
+            return NULL;
+        }
+        model->materials[name] = mat->second;
+    }
+    
+    /* The arrays are plain bulk copies out of the mapping, and the tables
+     * are the same shape as the Model's */
+    model->vertices.assign(vertices, vertices + nfloats);
+    model->normals.assign(normals, normals + nnormals);
+    model->texture.assign(texture, texture + ntexture);
+    model->elements.resize(nindices);
+    GLuint max_index = 0;
+    for(size_t i = 0; i < nindices; ++i) {
+        GLuint index = indices[i];
+        max_index = (index > max_index ? index : max_index);
+        model->elements[i] = index;
+    }
+    if(nindices > 0 && size_t(max_index) >= nfloats / 3) {
+        delete model;
+        return NULL;
+    }
+    
+    for(size_t i = 0; i < nobjects; ++i) {
+        if(!view.name(objects[i].name, name)) {
+            delete model;
+            return NULL;
+        }
+        model->add_object(model->symbols.intern(name));
+        
+        size_t gend = size_t(objects[i].first + objects[i].count);
+        for(size_t g = size_t(objects[i].first); g < gend; ++g) {
+            if(!view.name(groups[g].name, name)) {
+                delete model;
+                return NULL;
+            }
+            model->add_group(model->symbols.intern(name));
+            
+            size_t mend = size_t(groups[g].first + groups[g].count);
+            for(size_t m = size_t(groups[g].first); m < mend; ++m) {
+                if(!view.name(mgroups[m].name, name)) {
+                    delete model;
+                    return NULL;
+                }
+                model->add_range(model->symbols.intern(name),
+                                 GLuint(mgroups[m].first),
+                                 GLuint(mgroups[m].count));
+            }
+        }
+    }
+    if(restamp) {
+        restamp_cache(Path(source), stamp);
+    }
+    return model;
+}
+
+typedef std::map<std::string, const Material *>::const_iterator mat_citer;
+bool ModelCache::Save(const char *source, const Model &model,
+                      const CacheKey &key,
+                      const std::vector<std::string> &depends)
+{
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, _cache_magic, sizeof(_cache_magic));
+    header.version = Version;
+    header.byteorder = _cache_byteorder;
+    header.flags = key.flags;
+    header.origin[0] = key.origin[0];
+    header.origin[1] = key.origin[1];
+    header.origin[2] = key.origin[2];
+    header.max_dim = key.max_dim;
+    if(!stamp_file(source, header.source) ||
+       !hash_file(source, header.hash))
+    {
+        return false;
+    }
+    
+    /* The range tables are the Model's own, with the names moved into the
+     * string table */
+    StringTable strings;
+    std::vector<CacheRange> objects, groups, mgroups;
+    for(size_t i = 0; i < model.objects.size(); ++i) {
+        const ModelObject &obj = model.objects[i];
+        CacheRange range = { strings.add(model.symbols, obj.name), obj.first,
+                             obj.count };
+        objects.push_back(range);
+    }
+    for(size_t i = 0; i < model.groups.size(); ++i) {
+        const ModelGroup &group = model.groups[i];
+        CacheRange range = { strings.add(model.symbols, group.name),
+                             group.first, group.count };
+        groups.push_back(range);
+    }
+    for(size_t i = 0; i < model.ranges.size(); ++i) {
+        const ModelRange &mgroup = model.ranges[i];
+        CacheRange range = { strings.add(model.symbols, mgroup.name),
+                             mgroup.first, mgroup.count };
+        mgroups.push_back(range);
+    }
+    uint64_t nindices = model.elements.size();
+    
+    std::vector<CacheMaterial> materials;
+    for(mat_citer iter = model.materials.begin();
+        iter != model.materials.end(); ++iter)
+    {
+        const Material &mat = *(iter->second);
+        CacheMaterial rec;
+        rec.name = strings.add(iter->first);
+        memcpy(rec.ka, mat.ka, sizeof(rec.ka));
+        memcpy(rec.kd, mat.kd, sizeof(rec.kd));
+        memcpy(rec.ks, mat.ks, sizeof(rec.ks));
+        rec.tr = mat.tr;
+        rec.ns = mat.ns;
+        rec.illum = mat.illum;
+        materials.push_back(rec);
+    }
+    
+    std::vector<CacheDepend> deps;
+    for(size_t i = 0; i < depends.size(); ++i) {
+        CacheDepend rec;
+        rec.path = strings.add(depends[i]);
+        stamp_file(depends[i].c_str(), rec.stamp);
+        deps.push_back(rec);
+    }
+    
+    /* Lay out the sections */
+    header.sections[SECTION_VERTICES].count = model.vertices.size();
+    header.sections[SECTION_NORMALS].count = model.normals.size();
+    header.sections[SECTION_TEXTURE].count = model.texture.size();
+    header.sections[SECTION_INDICES].count = nindices;
+    header.sections[SECTION_OBJECTS].count = objects.size();
+    header.sections[SECTION_GROUPS].count = groups.size();
+    header.sections[SECTION_MATGROUPS].count = mgroups.size();
+    header.sections[SECTION_MATERIALS].count = materials.size();
+    header.sections[SECTION_DEPENDS].count = deps.size();
+    header.sections[SECTION_STRINGS].count = strings.data.size();
+    size_t offset = align_up(sizeof(CacheHeader));
+    for(int i = 0; i < SECTION_COUNT; ++i) {
+        header.sections[i].offset = offset;
+        offset += align_up(size_t(header.sections[i].count) *
+                           _section_size[i]);
+    }
+    
+    /* Write to a temporary file and move it into place, so a reader never
+     * sees a partially written cache. */
+    std::string path = Path(source);
+    std::vector<char> tmpname(path.begin(), path.end());
+    const char suffix[] = ".XXXXXX";
+    tmpname.insert(tmpname.end(), suffix, suffix + sizeof(suffix));
+    int fd = mkstemp(&(tmpname[0]));
+    if(fd < 0) {
+        return false;
+    }
+    FILE *fp = fdopen(fd, "wb");
+    if(fp == NULL) {
+        close(fd);
+        unlink(&(tmpname[0]));
+        return false;
+    }
+    
+    bool ok = write_section(fp, &header, sizeof(header));
+    ok = ok && write_section(fp, model.vertices.data(),
+                             model.vertices.size() * sizeof(GLfloat));
+    ok = ok && write_section(fp, model.normals.data(),
+                             model.normals.size() * sizeof(GLfloat));
+    ok = ok && write_section(fp, model.texture.data(),
+                             model.texture.size() * sizeof(GLfloat));
+    ok = ok && write_section(fp, model.elements.data(),
+                             size_t(nindices) * sizeof(GLuint));
+    ok = ok && write_section(fp, objects.data(),
+                             objects.size() * sizeof(CacheRange));
+    ok = ok && write_section(fp, groups.data(),
+                             groups.size() * sizeof(CacheRange));
+    ok = ok && write_section(fp, mgroups.data(),
+                             mgroups.size() * sizeof(CacheRange));
+    ok = ok && write_section(fp, materials.data(),
+                             materials.size() * sizeof(CacheMaterial));
+    ok = ok && write_section(fp, deps.data(),
+                             deps.size() * sizeof(CacheDepend));
+    ok = ok && write_section(fp, strings.data.data(), strings.data.size());
+    
+    if(fclose(fp) != 0) {
+        ok = false;
+    }
+    if(ok && rename(&(tmpname[0]), path.c_str()) != 0) {
+        ok = false;
+    }
+    if(!ok) {
+        unlink(&(tmpname[0]));
+    }
+    return ok;
+}
@@ -0,0 +1,97 @@
+/**
+ * ModelFuture:
+ * Runs a single WavefrontLoader::load on a dedicated thread, so the caller
+ * (normally the GLUT main loop) keeps running while large models parse.
+ */
+
+#include "generic/ModelFuture.hpp"
+#include "generic/Model.hpp"
+#include "generic/WavefrontLoader.hpp"
+
+#include <exception>
+
+using namespace cs354;
+
+void * ModelFuture::Worker(void *arg) {
+    static_cast<ModelFuture *>(arg)->run();
+    return NULL;
+}
+
+ModelFuture::ModelFuture(WavefrontLoader *loader, const char *fname,
+                         const CacheKey &key) :
+    loader(loader), fname(fname), key(key), current(LOADING), model(NULL),
+    joinable(false)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&finished, NULL);
+    
+    if(pthread_create(&thread, NULL, ModelFuture::Worker, this) == 0) {
+        joinable = true;
+    }else {
+        /* No thread to be had; load now rather than not at all */
+        run();
+    }
+}
+ModelFuture::~ModelFuture() {
+    join();
+    delete model;
+    pthread_cond_destroy(&finished);
+    pthread_mutex_destroy(&lock);
+}
+
+ModelFuture::State ModelFuture::state() {
+    pthread_mutex_lock(&lock);
+    State s = current;
+    pthread_mutex_unlock(&lock);
+    return s;
+}
+ModelFuture::State ModelFuture::wait() {
+    pthread_mutex_lock(&lock);
+    while(current == LOADING) {
+        pthread_cond_wait(&finished, &lock);
+    }
+    State s = current;
+    pthread_mutex_unlock(&lock);
+    return s;
+}
+
+Model * ModelFuture::take() {
+    if(state() != READY) {
+        return NULL;
+    }
+    /* The worker is done with everything once the state is set */
+    join();
+    Model *m = model;
+    model = NULL;
+    return m;
+}
+
+const std::string & ModelFuture::error() const {
+    return message;
+}
+
+void ModelFuture::run() {
+    Model *m = NULL;
+    std::string err;
+    try {
+        m = loader->load(fname.c_str(), key);
+    }catch(std::exception &e) {
+        err = e.what();
+    }catch(...) {
+        err = "Unknown error";
+    }
+    
+    pthread_mutex_lock(&lock);
+    model = m;
+    message = err;
+    current = (m != NULL ? READY : FAILED);
+    pthread_cond_broadcast(&finished);
+    pthread_mutex_unlock(&lock);
+}
+
+void ModelFuture::join() {
+    if(joinable) {
+        pthread_join(thread, NULL);
+        joinable = false;
+    }
+}
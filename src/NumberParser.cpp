@@ -0,0 +1,278 @@
+/**
+ * NumberParser:
+ * Fast decimal parsing for the .obj and .mtl readers.
+ * Digits are gathered into a 64 bit mantissa, using SWAR to convert up to
+ * eight at a time on little endian machines. Floats are then finished with
+ * Clinger's fast path: if the mantissa and the power of ten are both exact
+ * in floating point, one correctly rounded multiply or divide gives the
+ * correctly rounded result. Anything that doesn't fit goes to strtof.
+ */
+
+#include "generic/NumberParser.hpp"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+
+using namespace cs354;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define NUMBER_PARSER_SWAR
+#endif
+/* The fast paths need float and double operations to round to their own
+ * precision, which isn't the case on the x87 FPU. */
+#if defined(__FLT_EVAL_METHOD__) && __FLT_EVAL_METHOD__ == 0
+# define NUMBER_PARSER_FAST_PATH
+#endif
+
+static const uint64_t _pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL
+};
+/* Every power of ten here is exactly representable */
+static const float _float_pow10[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const double _double_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+/* A uint64_t holds any 19 digit number */
+static const int _max_digits = 19;
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+#ifdef NUMBER_PARSER_SWAR
+/* Counts the digits at the start of the eight bytes at p and returns them,
+ * putting their value in 'val'. */
+static inline unsigned int swar_digits(const char *p, uint64_t &val) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    
+    /* A byte is a digit if its high nibble is 3 and adding 6 doesn't carry
+     * out of its low nibble. Digits leave a zero byte here. */
+    uint64_t bad = ((v & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL) |
+        (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) ^
+         0x3030303030303030ULL);
+    /* Set the top bit of every non-zero byte; the first one ends the run */
+    bad = (((bad & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | bad) &
+        0x8080808080808080ULL;
+    unsigned int n = (bad == 0 ? 8 : __builtin_ctzll(bad) / 8);
+    if(n == 0) {
+        val = 0;
+        return 0;
+    }
+    
+    /* The first character is the low byte. Shifting the digits to the top
+     * drops whatever followed them and leaves zeros to act as leading zero
+     * digits, so the usual eight digit conversion works for any length. */
+    v -= 0x3030303030303030ULL;
+    v <<= 8 * (8 - n);
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+         (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))))
+        >> 32;
+    val = uint32_t(v);
+    return n;
+}
+#endif
+
+/* Appends a run of digits to 'acc', adding the number read to 'count'. Past
+ * _max_digits the value of 'acc' is meaningless. */
+static inline const char * scan_digits(const char *p, const char *end,
+                                       uint64_t &acc, int &count)
+{
+#ifdef NUMBER_PARSER_SWAR
+    while(end - p >= 8) {
+        uint64_t chunk;
+        unsigned int n = swar_digits(p, chunk);
+        acc = acc * _pow10[n] + chunk;
+        p += n;
+        count += n;
+        if(n < 8) {
+            return p;
+        }
+    }
+#endif
+    while(p < end && is_digit(*p)) {
+        acc = acc * 10 + uint64_t(*p - '0');
+        p++;
+        count++;
+    }
+    return p;
+}
+
+#ifdef NUMBER_PARSER_FAST_PATH
+/* Whether d lies exactly halfway between two floats. Only meaningful for
+ * values in the normal float range. */
+static inline bool float_midpoint(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    /* A double has 29 more mantissa bits than a float */
+    return (bits & 0x1FFFFFFFULL) == 0x10000000ULL;
+}
+#endif
+
+/* mantissa * 10^exp10 for non-zero mantissas, when it can be done exactly.
+ * Returns false if the slow path is needed. */
+static inline bool fast_float(uint64_t mantissa, int ndigits, int exp10,
+                              float &result)
+{
+#ifdef NUMBER_PARSER_FAST_PATH
+    if(ndigits > _max_digits) {
+        return false;
+    }
+    if(mantissa <= (1ULL << 24) && exp10 >= -10 && exp10 <= 10) {
+        /* Both operands exact in a float */
+        result = float(mantissa);
+        if(exp10 < 0) {
+            result /= _float_pow10[-exp10];
+        }else {
+            result *= _float_pow10[exp10];
+        }
+        return true;
+    }
+    if(mantissa < (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+        /* Both operands exact in a double, so d is correctly rounded. Going
+         * on to a float rounds a second time, which only goes wrong if d
+         * landed exactly on a midpoint between two floats. These values are
+         * all well inside the normal float range. */
+        double d = double(mantissa);
+        if(exp10 < 0) {
+            d /= _double_pow10[-exp10];
+        }else {
+            d *= _double_pow10[exp10];
+        }
+        if(float_midpoint(d)) {
+            return false;
+        }
+        result = float(d);
+        return true;
+    }
+#endif
+    return false;
+}
+
+/* Slow path for anything the fast paths can't do exactly */
+static float parse_fallback(const char *begin, const char *end) {
+    char buff[64];
+    size_t len = end - begin;
+    if(len < sizeof(buff)) {
+        memcpy(buff, begin, len);
+        buff[len] = '\0';
+        return strtof(buff, NULL);
+    }
+    return strtof(std::string(begin, end).c_str(), NULL);
+}
+
+const char * NumberParser::Int(const char *pos, const char *end, int &val) {
+    const char *p = pos;
+    bool neg = false;
+    if(p < end && (*p == '-' || *p == '+')) {
+        neg = (*p == '-');
+        p++;
+    }
+    if(p >= end || !is_digit(*p)) {
+        return NULL;
+    }
+    
+    while(p < end && *p == '0') {
+        p++;
+    }
+    uint64_t acc = 0;
+    int ndigits = 0;
+    p = scan_digits(p, end, acc, ndigits);
+    
+    /* Out of range values are clamped */
+    uint64_t limit = (neg ? uint64_t(INT_MAX) + 1 : uint64_t(INT_MAX));
+    if(ndigits > _max_digits || acc > limit) {
+        acc = limit;
+    }
+    val = (neg ? int(-int64_t(acc)) : int(acc));
+    return p;
+}
+
+const char * NumberParser::Float(const char *pos, const char *end,
+                                 float &val)
+{
+    const char *p = pos;
+    bool neg = false;
+    if(p < end && (*p == '-' || *p == '+')) {
+        neg = (*p == '-');
+        p++;
+    }
+    if(p >= end || !is_digit(*p)) {
+        return NULL;
+    }
+    
+    /* Leading zeros don't count towards the digit limit */
+    uint64_t mantissa = 0;
+    int ndigits = 0, exp10 = 0;
+    while(p < end && *p == '0') {
+        p++;
+    }
+    p = scan_digits(p, end, mantissa, ndigits);
+    if(p < end && *p == '.') {
+        const char *frac = ++p;
+        if(ndigits == 0) {
+            while(p < end && *p == '0') {
+                p++;
+            }
+        }
+        p = scan_digits(p, end, mantissa, ndigits);
+        exp10 -= int(p - frac);
+    }
+    /* Only take the exponent if there are digits to go with it */
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool exp_neg = false;
+        if(q < end && (*q == '-' || *q == '+')) {
+            exp_neg = (*q == '-');
+            q++;
+        }
+        if(q < end && is_digit(*q)) {
+            int exp = 0;
+            while(q < end && is_digit(*q)) {
+                if(exp < 100000) {
+                    exp = exp * 10 + (*q - '0');
+                }
+                q++;
+            }
+            exp10 += (exp_neg ? -exp : exp);
+            p = q;
+        }
+    }
+    
+    float result;
+    if(ndigits == 0) {
+        result = 0.0f;
+    }else if(!fast_float(mantissa, ndigits, exp10, result)) {
+        val = parse_fallback(pos, p);
+        return p;
+    }
+    val = (neg ? -result : result);
+    return p;
+}
+
+const char * NumberParser::Face(const char *pos, const char *end,
+                                int args[3])
+{
+    args[0] = args[1] = args[2] = 0;
+    const char *p = Int(pos, end, args[0]);
+    if(p == NULL || p >= end || *p != '/') {
+        return p;
+    }
+    p++;
+    if(p < end && *p == '/') {
+        return Int(p + 1, end, args[2]);
+    }
+    p = Int(p, end, args[1]);
+    if(p != NULL && p < end && *p == '/') {
+        return Int(p + 1, end, args[2]);
+    }
+    return p;
+}
@@ -0,0 +1,332 @@
+/**
+ * Primitives:
+ * The GLUT shapes as cached meshes. The curved ones are grids of vertices
+ * over two angles (or an angle and a height); the grid's last column
+ * repeats its first so the normals can differ along the seam, and the cone
+ * and sphere have a row of coincident vertices at their poles, one for each
+ * column's normal.
+ */
+
+#include "generic/Primitives.hpp"
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+using namespace cs354;
+
+#define PI_2 6.28318530718
+
+enum PrimitiveShape {
+    SHAPE_SPHERE,
+    SHAPE_TORUS,
+    SHAPE_CONE,
+    SHAPE_CYLINDER,
+    SHAPE_CUBE
+};
+
+/* A shape and the arguments it was built with */
+struct PrimitiveKey {
+    PrimitiveKey(PrimitiveShape shape, GLfloat a, GLfloat b, int i, int j) :
+        shape(shape), a(a), b(b), i(i), j(j)
+    { }
+    
+    bool operator<(const PrimitiveKey &rhs) const {
+        if(shape != rhs.shape) {
+            return shape < rhs.shape;
+        }
+        if(a != rhs.a) {
+            return a < rhs.a;
+        }
+        if(b != rhs.b) {
+            return b < rhs.b;
+        }
+        if(i != rhs.i) {
+            return i < rhs.i;
+        }
+        return j < rhs.j;
+    }
+    
+    PrimitiveShape shape;
+    GLfloat a, b;
+    int i, j;
+};
+
+static std::map<PrimitiveKey, Mesh *> _meshes;
+
+/* How add_grid() treats the first and last rows */
+enum GridFlags {
+    GRID_TOP_POLE = 1,    /*< The first row is all one point */
+    GRID_BOTTOM_POLE = 2, /*< The last row is all one point */
+    GRID_WRAPS = 4        /*< The last row repeats the first */
+};
+
+/* cos and sin of 'count' + 1 angles evenly spaced over [0, range]. A full
+ * circle ends exactly where it started. */
+static void angles(int count, double range, std::vector<double> &cosines,
+                   std::vector<double> &sines)
+{
+    cosines.resize(size_t(count) + 1);
+    sines.resize(size_t(count) + 1);
+    for(int n = 0; n <= count; ++n) {
+        double angle = range * double(n) / double(count);
+        cosines[n] = cos(angle);
+        sines[n] = sin(angle);
+    }
+    if(range == PI_2) {
+        cosines[count] = cosines[0];
+        sines[count] = sines[0];
+    }
+}
+
+static void add_vertex(Mesh &mesh, double x, double y, double z, double nx,
+                       double ny, double nz)
+{
+    mesh.vertices.push_back(GLfloat(x));
+    mesh.vertices.push_back(GLfloat(y));
+    mesh.vertices.push_back(GLfloat(z));
+    mesh.normals.push_back(GLfloat(nx));
+    mesh.normals.push_back(GLfloat(ny));
+    mesh.normals.push_back(GLfloat(nz));
+}
+
+/* Connects a grid of (columns + 1) * (rows + 1) vertices, added row by row
+ * starting at 'first'. Stepping down a row crossed with stepping along it
+ * has to point out of the surface. Lines go along every row and column,
+ * leaving out the poles and repeated rows. */
+static void add_grid(Mesh &mesh, GLuint first, int columns, int rows,
+                     int flags)
+{
+    GLuint stride = GLuint(columns) + 1;
+    for(int r = 0; r < rows; ++r) {
+        for(int c = 0; c < columns; ++c) {
+            GLuint a = first + GLuint(r) * stride + GLuint(c);
+            GLuint b = a + stride, d = a + 1;
+            GLuint e = b + 1;
+            if(!((flags & GRID_BOTTOM_POLE) && r == rows - 1)) {
+                GLuint tri[3] = { a, b, e };
+                mesh.triangles.insert(mesh.triangles.end(), tri, tri + 3);
+            }
+            if(!((flags & GRID_TOP_POLE) && r == 0)) {
+                GLuint tri[3] = { a, e, d };
+                mesh.triangles.insert(mesh.triangles.end(), tri, tri + 3);
+            }
+            GLuint line[2] = { a, b };
+            mesh.lines.insert(mesh.lines.end(), line, line + 2);
+        }
+    }
+    for(int r = 0; r <= rows; ++r) {
+        if((r == 0 && (flags & GRID_TOP_POLE)) ||
+           (r == rows && (flags & (GRID_BOTTOM_POLE | GRID_WRAPS))))
+        {
+            continue;
+        }
+        for(int c = 0; c < columns; ++c) {
+            GLuint a = first + GLuint(r) * stride + GLuint(c);
+            GLuint line[2] = { a, a + 1 };
+            mesh.lines.insert(mesh.lines.end(), line, line + 2);
+        }
+    }
+}
+
+/* A disk at height z, facing up the z axis if 'up' and down it otherwise */
+static void add_cap(Mesh &mesh, double radius, double z, bool up,
+                    const std::vector<double> &cosines,
+                    const std::vector<double> &sines)
+{
+    GLuint center = GLuint(mesh.vertices.size() / 3);
+    size_t slices = cosines.size() - 1;
+    double nz = (up ? 1.0 : -1.0);
+    add_vertex(mesh, 0.0, 0.0, z, 0.0, 0.0, nz);
+    for(size_t n = 0; n < slices; ++n) {
+        add_vertex(mesh, cosines[n] * radius, sines[n] * radius, z, 0.0, 0.0,
+                   nz);
+    }
+    for(size_t n = 0; n < slices; ++n) {
+        GLuint v1 = center + 1 + GLuint(n);
+        GLuint v2 = center + 1 + GLuint((n + 1) % slices);
+        GLuint tri[3] = { center, (up ? v1 : v2), (up ? v2 : v1) };
+        mesh.triangles.insert(mesh.triangles.end(), tri, tri + 3);
+    }
+}
+
+static void build_sphere(Mesh &mesh, const PrimitiveKey &key) {
+    double radius = key.a;
+    int slices = key.i, stacks = key.j;
+    std::vector<double> cos_t, sin_t, cos_p, sin_p;
+    angles(slices, PI_2, cos_t, sin_t);
+    angles(stacks, PI_2 / 2.0, cos_p, sin_p);
+    /* Exact poles */
+    sin_p[0] = sin_p[stacks] = 0.0;
+    cos_p[stacks] = -1.0;
+    
+    for(int r = 0; r <= stacks; ++r) {
+        for(int c = 0; c <= slices; ++c) {
+            double nx = cos_t[c] * sin_p[r];
+            double ny = sin_t[c] * sin_p[r];
+            double nz = cos_p[r];
+            add_vertex(mesh, nx * radius, ny * radius, nz * radius, nx, ny,
+                       nz);
+        }
+    }
+    add_grid(mesh, 0, slices, stacks, GRID_TOP_POLE | GRID_BOTTOM_POLE);
+}
+
+static void build_torus(Mesh &mesh, const PrimitiveKey &key) {
+    double inner = key.a, outer = key.b;
+    int sides = key.i, rings = key.j;
+    std::vector<double> cos_r, sin_r, cos_s, sin_s;
+    angles(rings, PI_2, cos_r, sin_r);
+    angles(sides, PI_2, cos_s, sin_s);
+    
+    for(int r = 0; r <= rings; ++r) {
+        for(int s = 0; s <= sides; ++s) {
+            double dist = outer + inner * cos_s[s];
+            add_vertex(mesh, cos_r[r] * dist, sin_r[r] * dist,
+                       inner * sin_s[s], cos_r[r] * cos_s[s],
+                       sin_r[r] * cos_s[s], sin_s[s]);
+        }
+    }
+    add_grid(mesh, 0, sides, rings, GRID_WRAPS);
+}
+
+static void build_cone(Mesh &mesh, const PrimitiveKey &key) {
+    double base = key.a, height = key.b;
+    int slices = key.i, stacks = key.j;
+    std::vector<double> cos_t, sin_t;
+    angles(slices, PI_2, cos_t, sin_t);
+    /* The side's normals lean up by the cone's slope */
+    double slant = sqrt(height * height + base * base);
+    double nxy = (slant == 0.0 ? 0.0 : height / slant);
+    double nz = (slant == 0.0 ? 1.0 : base / slant);
+    
+    /* Rows go down from the tip */
+    for(int r = 0; r <= stacks; ++r) {
+        double t = double(r) / double(stacks);
+        for(int c = 0; c <= slices; ++c) {
+            add_vertex(mesh, cos_t[c] * base * t, sin_t[c] * base * t,
+                       height * (1.0 - t), cos_t[c] * nxy, sin_t[c] * nxy,
+                       nz);
+        }
+    }
+    add_grid(mesh, 0, slices, stacks, GRID_TOP_POLE);
+    add_cap(mesh, base, 0.0, false, cos_t, sin_t);
+}
+
+static void build_cylinder(Mesh &mesh, const PrimitiveKey &key) {
+    double radius = key.a, height = key.b;
+    int slices = key.i, stacks = key.j;
+    std::vector<double> cos_t, sin_t;
+    angles(slices, PI_2, cos_t, sin_t);
+    
+    /* Rows go down from the top */
+    for(int r = 0; r <= stacks; ++r) {
+        double z = height * (1.0 - double(r) / double(stacks));
+        for(int c = 0; c <= slices; ++c) {
+            add_vertex(mesh, cos_t[c] * radius, sin_t[c] * radius, z,
+                       cos_t[c], sin_t[c], 0.0);
+        }
+    }
+    add_grid(mesh, 0, slices, stacks, 0);
+    add_cap(mesh, radius, height, true, cos_t, sin_t);
+    add_cap(mesh, radius, 0.0, false, cos_t, sin_t);
+}
+
+/* Corners of each face of a cube from -1 to 1, counter-clockwise from
+ * outside, and the face's normal. The faces are in GLUT's order, which
+ * decides the normal of the edges in the wireframe. */
+static const GLfloat _cube_faces[6][5][3] = {
+    { { -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 }, { 0, 0, 1 } },
+    { { 1, -1, -1 }, { 1, 1, -1 }, { 1, 1, 1 }, { 1, -1, 1 }, { 1, 0, 0 } },
+    { { -1, 1, -1 }, { -1, 1, 1 }, { 1, 1, 1 }, { 1, 1, -1 }, { 0, 1, 0 } },
+    { { -1, -1, -1 }, { -1, -1, 1 }, { -1, 1, 1 }, { -1, 1, -1 },
+      { -1, 0, 0 } },
+    { { -1, -1, -1 }, { 1, -1, -1 }, { 1, -1, 1 }, { -1, -1, 1 },
+      { 0, -1, 0 } },
+    { { -1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 }, { 1, -1, -1 },
+      { 0, 0, -1 } }
+};
+
+static void build_cube(Mesh &mesh, const PrimitiveKey &key) {
+    double half = key.a / 2.0;
+    for(GLuint f = 0; f < 6; ++f) {
+        const GLfloat (*face)[3] = _cube_faces[f];
+        for(int v = 0; v < 4; ++v) {
+            add_vertex(mesh, face[v][0] * half, face[v][1] * half,
+                       face[v][2] * half, face[4][0], face[4][1],
+                       face[4][2]);
+        }
+        /* Each face is outlined, so every edge is drawn twice */
+        GLuint first = f * 4;
+        GLuint tris[6] = { first, first + 1, first + 2,
+                           first, first + 2, first + 3 };
+        GLuint edges[8] = { first, first + 1, first + 1, first + 2,
+                            first + 2, first + 3, first + 3, first };
+        mesh.triangles.insert(mesh.triangles.end(), tris, tris + 6);
+        mesh.lines.insert(mesh.lines.end(), edges, edges + 8);
+    }
+}
+
+/* The mesh for the key, built and uploaded if it's new. The copies in
+ * memory aren't needed once it's uploaded. */
+static Mesh & cached(const PrimitiveKey &key,
+                     void (*build)(Mesh &, const PrimitiveKey &))
+{
+    std::map<PrimitiveKey, Mesh *>::iterator found = _meshes.find(key);
+    if(found != _meshes.end()) {
+        return *(found->second);
+    }
+    
+    Mesh *mesh = new Mesh();
+    /* GLUT draws nothing for these either */
+    if(key.i > 0 && (key.j > 0 || key.shape == SHAPE_CUBE)) {
+        build(*mesh, key);
+    }
+    mesh->upload();
+    mesh->clear();
+    _meshes.insert(std::make_pair(key, mesh));
+    return *mesh;
+}
+
+/**************************************************/
+/* Static Interface */
+Mesh & Primitives::Sphere(GLfloat radius, int slices, int stacks) {
+    PrimitiveKey key(SHAPE_SPHERE, radius, 0.0f, slices, stacks);
+    return cached(key, build_sphere);
+}
+
+Mesh & Primitives::Torus(GLfloat inner, GLfloat outer, int sides,
+                         int rings)
+{
+    PrimitiveKey key(SHAPE_TORUS, inner, outer, sides, rings);
+    return cached(key, build_torus);
+}
+
+Mesh & Primitives::Cone(GLfloat base, GLfloat height, int slices,
+                        int stacks)
+{
+    PrimitiveKey key(SHAPE_CONE, base, height, slices, stacks);
+    return cached(key, build_cone);
+}
+
+Mesh & Primitives::Cylinder(GLfloat radius, GLfloat height, int slices,
+                            int stacks)
+{
+    PrimitiveKey key(SHAPE_CYLINDER, radius, height, slices, stacks);
+    return cached(key, build_cylinder);
+}
+
+Mesh & Primitives::Cube(GLfloat size) {
+    PrimitiveKey key(SHAPE_CUBE, size, 0.0f, 1, 0);
+    return cached(key, build_cube);
+}
+
+void Primitives::Release() {
+    std::map<PrimitiveKey, Mesh *>::iterator it;
+    for(it = _meshes.begin(); it != _meshes.end(); ++it) {
+        it->second->release();
+        delete it->second;
+    }
+    _meshes.clear();
+}
+/**************************************************/
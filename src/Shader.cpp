@@ -11,19 +11,88 @@
 
 #include "generic/Shader.hpp"
 
+#include "generic/GLState.hpp"
+#include "generic/MaterialTable.hpp"
 #include "generic/Model.hpp"
+#include "generic/ModelCache.hpp"
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <stdio.h>
 #include <stdexcept>
+#include <unistd.h>
 
 using namespace cs354;
 
+/* Every uniform name any Shader has seen, made on first use so ids can be
+ * taken during static initialization */
+static SymbolTable & uniform_names() {
+    static SymbolTable names;
+    return names;
+}
+
+/* Program binary cache files: this header, then the binary */
+static const char _program_magic[8] = { 'C', 'S', '3', '5', '4', 'P',
+                                        'R', 'G' };
+static const uint32_t _program_version = 1;
+struct ProgramHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;  /*< From glGetProgramBinary */
+    uint64_t source;  /*< Hash of the shader types and sources */
+    uint64_t driver;  /*< Hash of the GL vendor, renderer and version */
+    uint64_t length;
+};
+
+/* Program binaries are core in 4.1 and an extension before that, and the
+ * driver may still not support any binary formats */
+static bool has_program_binary() {
+#ifdef __MAC__
+    return false;
+#else
+    bool supported = false;
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if(version != NULL) {
+        int major = atoi(version);
+        const char *dot = strchr(version, '.');
+        int minor = (dot == NULL ? 0 : atoi(dot + 1));
+        supported = (major > 4 || (major == 4 && minor >= 1));
+    }
+    if(!supported) {
+        const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+        supported = extensions != NULL &&
+                    strstr(extensions, "GL_ARB_get_program_binary") != NULL;
+    }
+    GLint formats = 0;
+    if(supported) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    return formats > 0;
+#endif
+}
+
+/* A binary is only good for the driver that made it */
+static uint64_t driver_hash() {
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    std::string driver;
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        const char *str = (const char *)glGetString(names[i]);
+        driver += (str == NULL ? "" : str);
+        driver += '\n';
+    }
+    return ModelCache::Hash(driver.data(), driver.size());
+}
+
 /* Static Interface */
 void Shader::UseDefaultShaders() {
-    glUseProgram(0);
+    GLState::UseProgram(0);
     MaterialLocations::Unbind();
 }
 
+UniformId Shader::Uniform(const char *name) {
+    return uniform_names().intern(name, strlen(name));
+}
+
 /* Non-static Interface */
 Shader::Shader() :
     program(0), linked(false)
@@ -45,19 +114,16 @@ void Shader::add(GLenum type, FILE *file) {
     if(linked) {
         throw std::runtime_error(std::string("Can't add to a linked shader"));
     }
-    
-    char buff[1025];
-    size_t read;
-    std::stringstream data(std::stringstream::in | std::stringstream::out);
     if(!file) {
         throw std::runtime_error(std::string("Invalid File Pointer"));
     }
     
-    while((read = fread(buff, 1, 1024, file)) > 0) {
-        buff[read] = '\0';
-        data << buff;
+    std::string str;
+    char buff[4096];
+    size_t read;
+    while((read = fread(buff, 1, sizeof(buff), file)) > 0) {
+        str.append(buff, read);
     }
-    std::string str = data.str();
     this->add(type, str);
 }
 
@@ -65,40 +131,16 @@ void Shader::add(GLenum type, std::string &progdata) {
     if(linked) {
         throw std::runtime_error(std::string("Can't add to a linked shader"));
     }
-    
-    GLuint shader;
-    GLint status, logLen;
-    const char *pdata, *strShaderType;
-    GLchar *infoLog;
-    std::stringstream err(std::stringstream::in | std::stringstream::out);
     if(type != GL_VERTEX_SHADER && type != GL_FRAGMENT_SHADER) {
         throw std::runtime_error(std::string("Invalid Shader Type"));
     }
-    shader = glCreateShader(type);
-    pdata = progdata.data();
-    glShaderSource(shader, 1, &pdata, NULL);
-    glCompileShader(shader);
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if(status == GL_FALSE) {
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
-        infoLog = new GLchar[logLen + 1];
-        glGetShaderInfoLog(shader, logLen, NULL, infoLog);
-        strShaderType = NULL;
-        switch(type) {
-        case GL_VERTEX_SHADER:
-            strShaderType = "Vertex Shader";
-            break;
-        case GL_FRAGMENT_SHADER:
-            strShaderType = "Fragment Shader";
-            break;
-        }
-        err << "Error compiling " << strShaderType << " :" << std::endl;
-        err << infoLog << std::endl;
-        delete[] infoLog;
-        throw std::runtime_error(err.str());
-    }
-    
-    shaders.push_back(shader);
+    /* Compiled by link(), unless the program binary is cached */
+    types.push_back(type);
+    sources.push_back(progdata);
+}
+
+void Shader::useCache(const std::string &dir) {
+    cacheDir = dir;
 }
 
 void Shader::link() {
@@ -111,38 +153,64 @@ void Shader::link() {
     size_t i, ssize;
     std::stringstream err(std::stringstream::in | std::stringstream::out);
     
-    ssize = shaders.size();
+    ssize = sources.size();
     if(ssize < 1) {
         throw std::runtime_error(std::string("No shaders to link"));
     }
     
     program = glCreateProgram();
-    for(i = 0; i < ssize; ++i) {
-        glAttachShader(program, shaders[i]);
-    }
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &status);
-    if(status == GL_FALSE) {
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLen);
-        infoLog = new GLchar[logLen + 1];
-        glGetProgramInfoLog(program, logLen, NULL, infoLog);
-        err << "Linker Error:" << std::endl;
-        err << infoLog << std::endl;
-        delete[] infoLog;
-        throw std::runtime_error(err.str());
+    bool cached = !cacheDir.empty() && has_program_binary();
+    if(!cached || !load_binary()) {
+        for(i = 0; i < ssize; ++i) {
+            shaders.push_back(compile(types[i], sources[i]));
+            glAttachShader(program, shaders[i]);
+        }
+        if(cached) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                GL_TRUE);
+        }
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if(status == GL_FALSE) {
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLen);
+            infoLog = new GLchar[logLen + 1];
+            glGetProgramInfoLog(program, logLen, NULL, infoLog);
+            err << "Linker Error:" << std::endl;
+            err << infoLog << std::endl;
+            delete[] infoLog;
+            throw std::runtime_error(err.str());
+        }
+        /* A cache that can't be written only costs time on the next run */
+        if(cached) {
+            save_binary();
+        }
     }
     
+    find_uniforms();
     locations.loc_ka = this->getUniform("Ka");
     locations.loc_kd = this->getUniform("Kd");
     locations.loc_ks = this->getUniform("Ks");
     locations.loc_tr = this->getUniform("Tr");
     locations.loc_ns = this->getUniform("Ns");
+    /* Shaders with a Materials block read the bound MaterialTable */
+    MaterialTable::Locate(program, locations);
+    /* Uniforms start at 0, which would flatten everything drawn without a
+     * Model to set the scale */
+    locations.loc_quant_offset = this->getUniform("QuantOffset");
+    locations.loc_quant_scale = this->getUniform("QuantScale");
+    if(locations.loc_quant_scale != -1) {
+        GLint previous;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+        glUseProgram(program);
+        glUniform1f(locations.loc_quant_scale, 1.0f);
+        glUseProgram(GLuint(previous));
+    }
     
     linked = true;
 }
 
 void Shader::use() {
-    glUseProgram(program);
+    GLState::UseProgram(program);
     /* Update the locations for the current material,
        set them to the default */
     MaterialLocations::Bind(*this);
@@ -153,9 +221,223 @@ GLuint Shader::handle() {
 }
 
 GLint Shader::getUniform(const char *name) {
+    UniformId id = uniform_names().find(name, strlen(name));
+    if(id != SymbolTable::None && id < uniforms.size()) {
+        GLint location = uniforms[id];
+        if(location != -1) {
+            return location;
+        }
+    }
     return glGetUniformLocation(program, name);
 }
+GLint Shader::getUniform(UniformId id) const {
+    if(id >= uniforms.size()) {
+        return -1;
+    }
+    return uniforms[id];
+}
+
+void Shader::setUniform1i(UniformId id, GLint x) {
+    check_in_use();
+    GLState::Uniform1i(getUniform(id), x);
+}
+void Shader::setUniform1f(UniformId id, GLfloat x) {
+    check_in_use();
+    GLState::Uniform1f(getUniform(id), x);
+}
+void Shader::setUniform3f(UniformId id, GLfloat x, GLfloat y, GLfloat z) {
+    check_in_use();
+    GLState::Uniform3f(getUniform(id), x, y, z);
+}
+void Shader::setUniform4f(UniformId id, GLfloat x, GLfloat y, GLfloat z,
+                          GLfloat w)
+{
+    check_in_use();
+    GLState::Uniform4f(getUniform(id), x, y, z, w);
+}
 
 const MaterialLocations & Shader::getLocations() const {
     return locations;
 }
+
+/* Private methods of Shader */
+void Shader::check_in_use() const {
+    if(!linked || GLState::CurrentProgram() != program) {
+        throw std::runtime_error(std::string("Setting a uniform of a "
+                                             "shader that isn't in use"));
+    }
+}
+
+void Shader::find_uniforms() {
+    GLint count = 0, length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+    std::vector<GLchar> name(size_t(length) + 1);
+    
+    SymbolTable &names = uniform_names();
+    for(GLint i = 0; i < count; ++i) {
+        GLsizei namelen = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, GLuint(i), length, &namelen, &size,
+                           &type, &(name[0]));
+        /* Members of uniform blocks don't have locations */
+        GLint location = glGetUniformLocation(program, &(name[0]));
+        if(location == -1) {
+            continue;
+        }
+        
+        /* Arrays are listed as their first element; they're found by the
+         * name of the array as well */
+        UniformId ids[2];
+        size_t nids = 0;
+        ids[nids++] = names.intern(&(name[0]), size_t(namelen));
+        if(namelen > 3 && strcmp(&(name[namelen - 3]), "[0]") == 0) {
+            ids[nids++] = names.intern(&(name[0]), size_t(namelen - 3));
+        }
+        for(size_t n = 0; n < nids; ++n) {
+            if(ids[n] >= uniforms.size()) {
+                uniforms.resize(ids[n] + 1, -1);
+            }
+            uniforms[ids[n]] = location;
+        }
+    }
+}
+
+GLuint Shader::compile(GLenum type, const std::string &progdata) {
+    GLuint shader;
+    GLint status, logLen;
+    const char *pdata, *strShaderType;
+    GLchar *infoLog;
+    std::stringstream err(std::stringstream::in | std::stringstream::out);
+    shader = glCreateShader(type);
+    pdata = progdata.c_str();
+    glShaderSource(shader, 1, &pdata, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(status == GL_FALSE) {
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
+        infoLog = new GLchar[logLen + 1];
+        glGetShaderInfoLog(shader, logLen, NULL, infoLog);
+        strShaderType = NULL;
+        switch(type) {
+        case GL_VERTEX_SHADER:
+            strShaderType = "Vertex Shader";
+            break;
+        case GL_FRAGMENT_SHADER:
+            strShaderType = "Fragment Shader";
+            break;
+        }
+        glDeleteShader(shader);
+        err << "Error compiling " << strShaderType << " :" << std::endl;
+        err << infoLog << std::endl;
+        delete[] infoLog;
+        throw std::runtime_error(err.str());
+    }
+    return shader;
+}
+
+uint64_t Shader::source_hash() const {
+    std::string data;
+    for(size_t i = 0; i < sources.size(); ++i) {
+        data.append((const char *)&(types[i]), sizeof(types[i]));
+        data += sources[i];
+        data += '\0';
+    }
+    return ModelCache::Hash(data.data(), data.size());
+}
+
+std::string Shader::cache_path() const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.cache",
+             (unsigned long long)source_hash());
+    return cacheDir + name;
+}
+
+bool Shader::load_binary() {
+    FILE *fp = fopen(cache_path().c_str(), "rb");
+    if(fp == NULL) {
+        return false;
+    }
+    
+    ProgramHeader header;
+    std::vector<char> binary;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && memcmp(header.magic, _program_magic,
+                      sizeof(_program_magic)) == 0;
+    ok = ok && header.version == _program_version && header.length > 0;
+    ok = ok && header.source == source_hash() &&
+         header.driver == driver_hash();
+    if(ok) {
+        binary.resize(size_t(header.length));
+        ok = fread(&(binary[0]), 1, binary.size(), fp) == binary.size();
+    }
+    fclose(fp);
+    if(!ok) {
+        return false;
+    }
+    
+    /* The driver may still reject it, after an update that kept the
+     * version string for instance. The program is replaced by a fresh one
+     * for compiling then. */
+    GLint status = GL_FALSE;
+    glProgramBinary(program, GLenum(header.format), &(binary[0]),
+                    GLsizei(binary.size()));
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status == GL_FALSE) {
+        GLState::ForgetProgram(program);
+        glDeleteProgram(program);
+        program = glCreateProgram();
+        return false;
+    }
+    return true;
+}
+
+bool Shader::save_binary() {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) {
+        return false;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, NULL, &format, &(binary[0]));
+    
+    ProgramHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, _program_magic, sizeof(_program_magic));
+    header.version = _program_version;
+    header.format = uint32_t(format);
+    header.source = source_hash();
+    header.driver = driver_hash();
+    header.length = uint64_t(length);
+    
+    /* Written to a temporary file and moved into place, like the model
+     * cache */
+    std::string path = cache_path();
+    std::vector<char> tmpname(path.begin(), path.end());
+    const char suffix[] = ".XXXXXX";
+    tmpname.insert(tmpname.end(), suffix, suffix + sizeof(suffix));
+    int fd = mkstemp(&(tmpname[0]));
+    if(fd < 0) {
+        return false;
+    }
+    FILE *fp = fdopen(fd, "wb");
+    if(fp == NULL) {
+        close(fd);
+        unlink(&(tmpname[0]));
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(&(binary[0]), 1, binary.size(), fp) == binary.size();
+    if(fclose(fp) != 0) {
+        ok = false;
+    }
+    if(ok && rename(&(tmpname[0]), path.c_str()) != 0) {
+        ok = false;
+    }
+    if(!ok) {
+        unlink(&(tmpname[0]));
+    }
+    return ok;
+}
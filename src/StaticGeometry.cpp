@@ -0,0 +1,79 @@
+/**
+ * StaticGeometry:
+ * Registry of meshes built from constant polygon tables. The tables are
+ * copied in, so they only have to outlive Register().
+ */
+
+#include "generic/StaticGeometry.hpp"
+
+#include <map>
+#include <stdexcept>
+
+using namespace cs354;
+
+static std::map<std::string, Mesh *> _meshes;
+
+/**************************************************/
+/* Static Interface */
+Mesh & StaticGeometry::Register(const std::string &name,
+                                const GLfloat *vertices,
+                                const GLfloat *colors, size_t nvertices,
+                                const GLuint *indices, size_t count,
+                                int sides)
+{
+    if(sides < 3) {
+        throw std::runtime_error(std::string("Polygons need at least 3 "
+                                             "sides"));
+    }
+    
+    Mesh *&mesh = _meshes[name];
+    if(mesh == NULL) {
+        mesh = new Mesh();
+    }else {
+        mesh->release();
+        mesh->clear();
+    }
+    
+    mesh->vertices.assign(vertices, vertices + nvertices * 3);
+    if(colors != NULL) {
+        mesh->colors.assign(colors, colors + nvertices * 3);
+    }
+    /* Polygon (a, b, c, d, ...) becomes (a, b, c), (a, c, d), ... */
+    size_t polygon = size_t(sides);
+    mesh->triangles.reserve((count / polygon) * (polygon - 2) * 3);
+    for(size_t first = 0; first + polygon <= count; first += polygon) {
+        for(size_t v = 1; v + 1 < polygon; ++v) {
+            mesh->triangles.push_back(indices[first]);
+            mesh->triangles.push_back(indices[first + v]);
+            mesh->triangles.push_back(indices[first + v + 1]);
+        }
+    }
+    return *mesh;
+}
+
+Mesh * StaticGeometry::Get(const std::string &name) {
+    std::map<std::string, Mesh *>::iterator found = _meshes.find(name);
+    if(found == _meshes.end()) {
+        return NULL;
+    }
+    return found->second;
+}
+
+void StaticGeometry::Upload() {
+    std::map<std::string, Mesh *>::iterator it;
+    for(it = _meshes.begin(); it != _meshes.end(); ++it) {
+        if(!it->second->uploaded()) {
+            it->second->upload();
+        }
+    }
+}
+
+void StaticGeometry::Release() {
+    std::map<std::string, Mesh *>::iterator it;
+    for(it = _meshes.begin(); it != _meshes.end(); ++it) {
+        it->second->release();
+        delete it->second;
+    }
+    _meshes.clear();
+}
+/**************************************************/
@@ -0,0 +1,200 @@
+/**
+ * SymbolTable:
+ * String interning for model names. Names are stored once, in the order
+ * they're first seen, and looked up through a hash of their bytes.
+ */
+
+#include "generic/SymbolTable.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace cs354;
+
+const Symbol SymbolTable::None = 0xFFFFFFFFu;
+
+static const size_t _min_capacity = 64;
+
+/* 64 bit FNV-1a */
+static inline uint64_t hash_bytes(const char *str, size_t len) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for(size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)str[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+static inline uint64_t hash_key(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    return key;
+}
+static inline uint64_t pack(uint32_t parent, Symbol sym) {
+    return (uint64_t(parent) << 32) | uint64_t(sym);
+}
+
+/**************************************************/
+SymbolTable::SymbolTable() :
+    slots(_min_capacity, None), mask(_min_capacity - 1)
+{ }
+SymbolTable::~SymbolTable() { }
+
+Symbol SymbolTable::intern(const char *str, size_t len) {
+    uint64_t hash = hash_bytes(str, len);
+    size_t pos = lookup(str, len, hash);
+    if(slots[pos] != None) {
+        return slots[pos];
+    }
+    
+    Symbol sym = Symbol(names.size());
+    slots[pos] = sym;
+    names.push_back(std::string(str, len));
+    hashes.push_back(hash);
+    /* Keep the table at most 3/4 full */
+    if(names.size() * 4 > slots.size() * 3) {
+        grow();
+    }
+    return sym;
+}
+Symbol SymbolTable::intern(const std::string &str) {
+    return intern(str.data(), str.size());
+}
+
+Symbol SymbolTable::find(const char *str, size_t len) const {
+    return slots[lookup(str, len, hash_bytes(str, len))];
+}
+Symbol SymbolTable::find(const std::string &str) const {
+    return find(str.data(), str.size());
+}
+
+const std::string & SymbolTable::name(Symbol sym) const {
+    return names[sym];
+}
+size_t SymbolTable::size() const {
+    return names.size();
+}
+
+void SymbolTable::clear() {
+    slots.assign(_min_capacity, None);
+    mask = _min_capacity - 1;
+    names.clear();
+    hashes.clear();
+}
+void SymbolTable::swap(SymbolTable &other) {
+    slots.swap(other.slots);
+    std::swap(mask, other.mask);
+    names.swap(other.names);
+    hashes.swap(other.hashes);
+}
+
+/* Private methods of SymbolTable */
+/* Returns the slot holding the name, or the empty slot it would go in */
+size_t SymbolTable::lookup(const char *str, size_t len, uint64_t hash) const {
+    size_t pos = size_t(hash) & mask;
+    for(;;) {
+        Symbol sym = slots[pos];
+        if(sym == None) {
+            return pos;
+        }
+        const std::string &name = names[sym];
+        if(hashes[sym] == hash && name.size() == len &&
+           std::memcmp(name.data(), str, len) == 0)
+        {
+            return pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+void SymbolTable::grow() {
+    slots.assign(slots.size() * 2, None);
+    mask = slots.size() - 1;
+    for(size_t sym = 0; sym < names.size(); ++sym) {
+        size_t pos = size_t(hashes[sym]) & mask;
+        while(slots[pos] != None) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = Symbol(sym);
+    }
+}
+/**************************************************/
+
+/**************************************************/
+SymbolIndex::SymbolIndex() {
+    clear();
+}
+SymbolIndex::~SymbolIndex() { }
+
+uint32_t SymbolIndex::insert(uint32_t parent, Symbol sym, uint32_t value,
+                             bool &inserted)
+{
+    uint64_t key = pack(parent, sym);
+    size_t pos = size_t(hash_key(key)) & mask;
+    for(;;) {
+        Slot &slot = slots[pos];
+        if(slot.value == SymbolTable::None) {
+            break;
+        }
+        if(slot.key == key) {
+            inserted = false;
+            return slot.value;
+        }
+        pos = (pos + 1) & mask;
+    }
+    
+    inserted = true;
+    slots[pos].key = key;
+    slots[pos].value = value;
+    count += 1;
+    if(count * 4 > slots.size() * 3) {
+        grow();
+    }
+    return value;
+}
+
+uint32_t SymbolIndex::find(uint32_t parent, Symbol sym) const {
+    uint64_t key = pack(parent, sym);
+    size_t pos = size_t(hash_key(key)) & mask;
+    for(;;) {
+        const Slot &slot = slots[pos];
+        if(slot.value == SymbolTable::None || slot.key == key) {
+            return slot.value;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+void SymbolIndex::clear() {
+    Slot empty = { 0, SymbolTable::None };
+    slots.assign(_min_capacity, empty);
+    mask = _min_capacity - 1;
+    count = 0;
+}
+void SymbolIndex::swap(SymbolIndex &other) {
+    slots.swap(other.slots);
+    std::swap(mask, other.mask);
+    std::swap(count, other.count);
+}
+
+/* Private methods of SymbolIndex */
+void SymbolIndex::grow() {
+    std::vector<Slot> old;
+    old.swap(slots);
+    
+    Slot empty = { 0, SymbolTable::None };
+    slots.assign(old.size() * 2, empty);
+    mask = slots.size() - 1;
+    
+    for(size_t i = 0; i < old.size(); ++i) {
+        if(old[i].value == SymbolTable::None) {
+            continue;
+        }
+        size_t pos = size_t(hash_key(old[i].key)) & mask;
+        while(slots[pos].value != SymbolTable::None) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = old[i];
+    }
+}
+/**************************************************/
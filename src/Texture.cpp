@@ -2,6 +2,7 @@
 #include "generic/Texture.hpp"
 
 #include "common.hpp"
+#include "generic/GLState.hpp"
 #include "generic/Image.hpp"
 
 #include <exception>
@@ -17,18 +18,17 @@ Texture::Texture(const Image &img) {
     
     int format = img.glFormat();
     uint32_t width = img.getWidth(), height = img.getHeight();
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLState::BindTexture(GL_TEXTURE_2D, handle);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
                  GL_UNSIGNED_BYTE, img.getData());
     GLenum error = glGetError();
     if(error != GL_NO_ERROR) {
-        glDeleteTextures(1, &handle);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::DeleteTextures(1, &handle);
         throw std::runtime_error(std::string("Could not upload texture data"));
     }
 }
 Texture::~Texture() {
-    glDeleteTextures(1, &handle);
+    GLState::DeleteTextures(1, &handle);
 }
@@ -0,0 +1,158 @@
+/**
+ * ThreadPool:
+ * A small pthreads based pool used for splitting up loader work. Tasks are
+ * handed over in batches; the thread submitting a batch helps work through
+ * the queue until its batch is finished.
+ */
+
+#include "generic/ThreadPool.hpp"
+
+#include <exception>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace cs354;
+
+Task::~Task() { }
+
+/* Static Interface */
+unsigned int ThreadPool::Cores() {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    return (ncpu < 1 ? 1 : (unsigned int)ncpu);
+}
+
+static ThreadPool *_global_pool = NULL;
+static pthread_once_t _global_once = PTHREAD_ONCE_INIT;
+static void _create_global_pool() {
+    /* The caller of run() also does work, so one less thread is needed */
+    _global_pool = new ThreadPool(ThreadPool::Cores() - 1);
+}
+ThreadPool & ThreadPool::Global() {
+    pthread_once(&_global_once, _create_global_pool);
+    return *_global_pool;
+}
+
+void * ThreadPool::Worker(void *arg) {
+    ThreadPool *pool = static_cast<ThreadPool *>(arg);
+    
+    pthread_mutex_lock(&(pool->lock));
+    for(;;) {
+        while(pool->jobs.empty() && !pool->shutdown) {
+            pthread_cond_wait(&(pool->work), &(pool->lock));
+        }
+        if(pool->jobs.empty()) {
+            break;
+        }
+        Job job = pool->jobs.front();
+        pool->jobs.pop_front();
+        
+        pthread_mutex_unlock(&(pool->lock));
+        pool->execute(job);
+        pthread_mutex_lock(&(pool->lock));
+        
+        job.batch->remaining -= 1;
+        if(job.batch->remaining == 0) {
+            pthread_cond_broadcast(&(pool->done));
+        }
+    }
+    pthread_mutex_unlock(&(pool->lock));
+    return NULL;
+}
+
+/* Non-static Interface */
+ThreadPool::ThreadPool(unsigned int nthreads) :
+    shutdown(false)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&work, NULL);
+    pthread_cond_init(&done, NULL);
+    
+    pthread_t thread;
+    for(unsigned int i = 0; i < nthreads; ++i) {
+        if(pthread_create(&thread, NULL, ThreadPool::Worker, this) != 0) {
+            /* Run with what we have; the caller always helps out */
+            break;
+        }
+        threads.push_back(thread);
+    }
+}
+ThreadPool::~ThreadPool() {
+    pthread_mutex_lock(&lock);
+    shutdown = true;
+    pthread_cond_broadcast(&work);
+    pthread_mutex_unlock(&lock);
+    
+    for(size_t i = 0; i < threads.size(); ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    pthread_cond_destroy(&done);
+    pthread_cond_destroy(&work);
+    pthread_mutex_destroy(&lock);
+}
+
+void ThreadPool::run(const std::vector<Task *> &tasks) {
+    if(tasks.empty()) {
+        return;
+    }
+    
+    Batch batch;
+    batch.remaining = tasks.size();
+    batch.failed = false;
+    
+    pthread_mutex_lock(&lock);
+    for(size_t i = 0; i < tasks.size(); ++i) {
+        Job job = { tasks[i], &batch };
+        jobs.push_back(job);
+    }
+    pthread_cond_broadcast(&work);
+    
+    /* Help out until our batch is done. Jobs from other batches may be
+     * picked up here as well, which is fine. */
+    while(batch.remaining > 0) {
+        if(jobs.empty()) {
+            pthread_cond_wait(&done, &lock);
+            continue;
+        }
+        Job job = jobs.front();
+        jobs.pop_front();
+        
+        pthread_mutex_unlock(&lock);
+        execute(job);
+        pthread_mutex_lock(&lock);
+        
+        job.batch->remaining -= 1;
+        if(job.batch->remaining == 0) {
+            pthread_cond_broadcast(&done);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    
+    if(batch.failed) {
+        throw std::runtime_error(batch.error);
+    }
+}
+
+unsigned int ThreadPool::size() const {
+    return threads.size() + 1;
+}
+
+void ThreadPool::execute(Job &job) {
+    try {
+        job.task->run();
+    }catch(std::exception &e) {
+        pthread_mutex_lock(&lock);
+        if(!job.batch->failed) {
+            job.batch->failed = true;
+            job.batch->error = e.what();
+        }
+        pthread_mutex_unlock(&lock);
+    }catch(...) {
+        pthread_mutex_lock(&lock);
+        if(!job.batch->failed) {
+            job.batch->failed = true;
+            job.batch->error = "Unknown error in task";
+        }
+        pthread_mutex_unlock(&lock);
+    }
+}
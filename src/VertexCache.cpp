@@ -0,0 +1,252 @@
+/**
+ * VertexCache:
+ * Forsyth's greedy triangle ordering. Every vertex is scored by where it
+ * sits in a simulated LRU cache and by how many triangles still use it;
+ * the next triangle drawn is the best scoring one touching the cache, so
+ * each step only rescores the vertices in the cache and their triangles.
+ */
+
+#include "generic/VertexCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace cs354;
+
+const size_t VertexCache::Size = 32;
+
+/* Scoring constants from the paper */
+static const float _cache_decay_power = 1.5f;
+static const float _last_triangle_score = 0.75f;
+static const float _valence_boost_scale = 2.0f;
+static const float _valence_boost_power = 0.5f;
+/* Valence scores are looked up below this, and computed above it */
+static const size_t _valence_table_size = 32;
+
+static const GLuint _no_triangle = 0xFFFFFFFFu;
+
+namespace {
+/* Score tables, filled in by the first Optimize() */
+class ScoreTable {
+public:
+    ScoreTable() :
+        cache(VertexCache::Size), valence(_valence_table_size)
+    {
+        for(size_t i = 0; i < cache.size(); ++i) {
+            if(i < 3) {
+                /* The last triangle's vertices get a fixed score, so the
+                 * ordering doesn't favor any one of them */
+                cache[i] = _last_triangle_score;
+            }else {
+                float scaler = 1.0f / float(VertexCache::Size - 3);
+                cache[i] = powf(1.0f - float(i - 3) * scaler,
+                                _cache_decay_power);
+            }
+        }
+        valence[0] = 0.0f;
+        for(size_t i = 1; i < valence.size(); ++i) {
+            valence[i] = valence_score(i);
+        }
+    }
+    
+    /* Vertices with no triangles left score -1 so they're never wanted */
+    float score(int cache_pos, size_t remaining) const {
+        if(remaining == 0) {
+            return -1.0f;
+        }
+        float result = (cache_pos < 0 ? 0.0f : cache[cache_pos]);
+        if(remaining < valence.size()) {
+            return result + valence[remaining];
+        }
+        return result + valence_score(remaining);
+    }
+private:
+    /* Vertices with few triangles left are boosted to get rid of them */
+    static float valence_score(size_t remaining) {
+        return _valence_boost_scale * powf(float(remaining),
+                                           -_valence_boost_power);
+    }
+    
+    std::vector<float> cache, valence;
+};
+
+/* What the optimizer tracks per vertex. The vertex's triangles that haven't
+ * been drawn yet are triangles[first, first + remaining). */
+struct OptVertex {
+    float score;
+    int cache_pos;
+    size_t first, remaining;
+};
+}
+
+static const ScoreTable & score_table() {
+    static const ScoreTable table;
+    return table;
+}
+
+/**************************************************/
+CacheMetrics::CacheMetrics() :
+    acmr(0.0), atvr(0.0)
+{ }
+
+CacheMetrics VertexCache::Measure(const GLuint *indices, size_t count,
+                                  size_t nvertices)
+{
+    CacheMetrics metrics;
+    if(count < 3) {
+        return metrics;
+    }
+    
+    /* A vertex is in the FIFO if it was added within the last Size misses */
+    std::vector<size_t> added(nvertices, 0);
+    std::vector<char> used(nvertices, 0);
+    size_t misses = 0, distinct = 0;
+    for(size_t i = 0; i < count; ++i) {
+        GLuint v = indices[i];
+        if(!used[v]) {
+            used[v] = 1;
+            distinct++;
+        }else if(misses - added[v] < Size) {
+            continue;
+        }
+        misses++;
+        added[v] = misses;
+    }
+    
+    metrics.acmr = double(misses) / double(count / 3);
+    metrics.atvr = double(misses) / double(distinct);
+    return metrics;
+}
+
+void VertexCache::Optimize(GLuint *indices, size_t count) {
+    size_t ntriangles = count / 3;
+    if(ntriangles < 2) {
+        return;
+    }
+    const ScoreTable &table = score_table();
+    
+    /* Number the vertices used by the list from zero, so everything below
+     * is sized by the list rather than by the whole model */
+    std::vector<GLuint> ids(indices, indices + ntriangles * 3);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    std::vector<GLuint> local(ntriangles * 3);
+    for(size_t i = 0; i < local.size(); ++i) {
+        local[i] = GLuint(std::lower_bound(ids.begin(), ids.end(),
+                                           indices[i]) - ids.begin());
+    }
+    
+    /* Triangles using each vertex */
+    std::vector<OptVertex> vertices(ids.size());
+    for(size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i].cache_pos = -1;
+        vertices[i].remaining = 0;
+    }
+    for(size_t i = 0; i < local.size(); ++i) {
+        vertices[local[i]].remaining++;
+    }
+    size_t offset = 0;
+    for(size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i].first = offset;
+        offset += vertices[i].remaining;
+        vertices[i].remaining = 0;
+    }
+    std::vector<GLuint> triangles(local.size());
+    for(size_t i = 0; i < local.size(); ++i) {
+        OptVertex &vert = vertices[local[i]];
+        triangles[vert.first + vert.remaining] = GLuint(i / 3);
+        vert.remaining++;
+    }
+    
+    for(size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i].score = table.score(-1, vertices[i].remaining);
+    }
+    std::vector<float> tri_score(ntriangles);
+    std::vector<char> drawn(ntriangles, 0);
+    GLuint best = 0;
+    for(size_t t = 0; t < ntriangles; ++t) {
+        const GLuint *tri = &(local[t * 3]);
+        tri_score[t] = vertices[tri[0]].score + vertices[tri[1]].score +
+                       vertices[tri[2]].score;
+        if(tri_score[t] > tri_score[best]) {
+            best = GLuint(t);
+        }
+    }
+    
+    /* The cache holds up to three extra vertices while a triangle is added;
+     * those have just fallen out of it. */
+    std::vector<GLuint> cache, next_cache;
+    cache.reserve(Size + 3);
+    next_cache.reserve(Size + 3);
+    std::vector<GLuint> order;
+    order.reserve(ntriangles * 3);
+    size_t cursor = 0;
+    while(order.size() < ntriangles * 3) {
+        if(best == _no_triangle) {
+            /* Nothing in the cache has triangles left; start over at the
+             * first triangle not drawn yet */
+            while(drawn[cursor]) {
+                cursor++;
+            }
+            best = GLuint(cursor);
+        }
+        
+        const GLuint *tri = &(local[best * 3]);
+        drawn[best] = 1;
+        order.push_back(ids[tri[0]]);
+        order.push_back(ids[tri[1]]);
+        order.push_back(ids[tri[2]]);
+        
+        /* Take the triangle off its vertices' lists */
+        next_cache.clear();
+        for(int c = 0; c < 3; ++c) {
+            OptVertex &vert = vertices[tri[c]];
+            GLuint *begin = &(triangles[vert.first]);
+            GLuint *end = begin + vert.remaining;
+            *std::find(begin, end, best) = *(end - 1);
+            vert.remaining--;
+            next_cache.push_back(tri[c]);
+        }
+        
+        /* The triangle's vertices move to the front of the cache */
+        for(size_t i = 0; i < cache.size(); ++i) {
+            GLuint v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2]) {
+                next_cache.push_back(v);
+            }
+        }
+        cache.swap(next_cache);
+        
+        /* Rescore everything in the cache, then pick the best triangle of
+         * theirs for next time */
+        for(size_t i = 0; i < cache.size(); ++i) {
+            OptVertex &vert = vertices[cache[i]];
+            vert.cache_pos = (i < Size ? int(i) : -1);
+            float score = table.score(vert.cache_pos, vert.remaining);
+            float delta = score - vert.score;
+            vert.score = score;
+            for(size_t j = 0; j < vert.remaining; ++j) {
+                tri_score[triangles[vert.first + j]] += delta;
+            }
+        }
+        if(cache.size() > Size) {
+            cache.resize(Size);
+        }
+        best = _no_triangle;
+        float best_score = -1.0f;
+        for(size_t i = 0; i < cache.size(); ++i) {
+            const OptVertex &vert = vertices[cache[i]];
+            for(size_t j = 0; j < vert.remaining; ++j) {
+                GLuint t = triangles[vert.first + j];
+                if(tri_score[t] > best_score) {
+                    best_score = tri_score[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    
+    std::copy(order.begin(), order.end(), indices);
+}
+/**************************************************/
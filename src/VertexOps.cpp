@@ -0,0 +1,215 @@
+/**
+ * VertexOps:
+ * Bounds and transforms over packed xyz arrays.
+ * With SSE, four vertices (twelve floats) are handled per step as three
+ * registers: [x0 y0 z0 x1] [y1 z1 x2 y2] [z2 x3 y3 z3]. Each lane always
+ * sees the same component, so min/max can run across the registers and be
+ * sorted out per component at the end, and the transform just needs the
+ * offset rotated the same way.
+ */
+
+#include "generic/VertexOps.hpp"
+#include "generic/ThreadPool.hpp"
+
+#include <cfloat>
+#include <vector>
+#ifdef __SSE__
+# include <xmmintrin.h>
+#endif
+
+using namespace cs354;
+
+/* Arrays smaller than this aren't worth handing to the pool */
+static const size_t _parallel_min_vertices = 1 << 16;
+
+/* Component seen by each lane of the three registers */
+static const int _lane_component[3][4] = {
+    { 0, 1, 2, 0 },
+    { 1, 2, 0, 1 },
+    { 2, 0, 1, 2 }
+};
+
+/* NaNs never replace a bound; 'val' must come first for that */
+static inline GLfloat min_of(GLfloat val, GLfloat bound) {
+    return (val < bound ? val : bound);
+}
+static inline GLfloat max_of(GLfloat val, GLfloat bound) {
+    return (val > bound ? val : bound);
+}
+
+static void bounds_block(const GLfloat *xyz, size_t count, BoundingBox &box) {
+    size_t i = 0;
+#ifdef __SSE__
+    if(count >= 4) {
+        /* _mm_min_ps returns its second operand if either is a NaN, which
+         * matches min_of() as long as the accumulator starts out finite */
+        __m128 mins[3], maxs[3];
+        for(int r = 0; r < 3; ++r) {
+            mins[r] = _mm_set1_ps(FLT_MAX);
+            maxs[r] = _mm_set1_ps(-FLT_MAX);
+        }
+        for(; i + 4 <= count; i += 4) {
+            const GLfloat *p = xyz + i * 3;
+            __m128 a = _mm_loadu_ps(p);
+            __m128 b = _mm_loadu_ps(p + 4);
+            __m128 c = _mm_loadu_ps(p + 8);
+            mins[0] = _mm_min_ps(a, mins[0]);
+            mins[1] = _mm_min_ps(b, mins[1]);
+            mins[2] = _mm_min_ps(c, mins[2]);
+            maxs[0] = _mm_max_ps(a, maxs[0]);
+            maxs[1] = _mm_max_ps(b, maxs[1]);
+            maxs[2] = _mm_max_ps(c, maxs[2]);
+        }
+        
+        GLfloat lmin[4], lmax[4];
+        for(int r = 0; r < 3; ++r) {
+            _mm_storeu_ps(lmin, mins[r]);
+            _mm_storeu_ps(lmax, maxs[r]);
+            for(int l = 0; l < 4; ++l) {
+                int c = _lane_component[r][l];
+                box.min[c] = min_of(lmin[l], box.min[c]);
+                box.max[c] = max_of(lmax[l], box.max[c]);
+            }
+        }
+    }
+#endif
+    for(; i < count; ++i) {
+        const GLfloat *p = xyz + i * 3;
+        for(int c = 0; c < 3; ++c) {
+            box.min[c] = min_of(p[c], box.min[c]);
+            box.max[c] = max_of(p[c], box.max[c]);
+        }
+    }
+}
+
+static void transform_block(GLfloat *xyz, size_t count,
+                            const GLfloat offset[3], GLfloat scale)
+{
+    size_t n = count * 3, i = 0;
+#ifdef __SSE__
+    __m128 s = _mm_set1_ps(scale);
+    if(offset == NULL) {
+        for(; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(xyz + i, _mm_mul_ps(_mm_loadu_ps(xyz + i), s));
+        }
+    }else {
+        __m128 t[3];
+        for(int r = 0; r < 3; ++r) {
+            const int *c = _lane_component[r];
+            t[r] = _mm_setr_ps(offset[c[0]], offset[c[1]], offset[c[2]],
+                               offset[c[3]]);
+        }
+        for(; i + 12 <= n; i += 12) {
+            GLfloat *p = xyz + i;
+            for(int r = 0; r < 3; ++r) {
+                __m128 v = _mm_add_ps(_mm_loadu_ps(p + r * 4), t[r]);
+                _mm_storeu_ps(p + r * 4, _mm_mul_ps(v, s));
+            }
+        }
+    }
+#endif
+    /* Both paths leave i on a vertex boundary */
+    if(offset == NULL) {
+        for(; i < n; ++i) {
+            xyz[i] = xyz[i] * scale;
+        }
+    }else {
+        for(; i < n; ++i) {
+            xyz[i] = (xyz[i] + offset[i % 3]) * scale;
+        }
+    }
+}
+
+/* Splits [0, count) into one range per task, each a multiple of four
+ * vertices long so the SSE loops don't leave a tail in the middle. */
+static size_t task_size(size_t count, size_t ntasks) {
+    size_t per = (count + ntasks - 1) / ntasks;
+    return (per + 3) & ~size_t(3);
+}
+
+namespace {
+class BoundsTask : public Task {
+public:
+    void run() {
+        bounds_block(xyz, count, box);
+    }
+    
+    const GLfloat *xyz;
+    size_t count;
+    BoundingBox box;
+};
+class TransformTask : public Task {
+public:
+    void run() {
+        transform_block(xyz, count, offset, scale);
+    }
+    
+    GLfloat *xyz;
+    size_t count;
+    const GLfloat *offset;
+    GLfloat scale;
+};
+}
+
+/**************************************************/
+BoundingBox::BoundingBox() {
+    min[0] = min[1] = min[2] = FLT_MAX;
+    max[0] = max[1] = max[2] = -FLT_MAX;
+}
+
+void BoundingBox::add(const BoundingBox &other) {
+    for(int c = 0; c < 3; ++c) {
+        min[c] = min_of(other.min[c], min[c]);
+        max[c] = max_of(other.max[c], max[c]);
+    }
+}
+/**************************************************/
+
+/**************************************************/
+BoundingBox VertexOps::Bounds(const GLfloat *xyz, size_t count) {
+    BoundingBox box;
+    ThreadPool &pool = ThreadPool::Global();
+    if(count < _parallel_min_vertices || pool.size() <= 1) {
+        bounds_block(xyz, count, box);
+        return box;
+    }
+    
+    size_t per = task_size(count, pool.size() * 4);
+    std::vector<BoundsTask> tasks((count + per - 1) / per);
+    std::vector<Task *> batch;
+    for(size_t i = 0; i < tasks.size(); ++i) {
+        size_t first = i * per;
+        tasks[i].xyz = xyz + first * 3;
+        tasks[i].count = (count - first < per ? count - first : per);
+        batch.push_back(&(tasks[i]));
+    }
+    pool.run(batch);
+    
+    for(size_t i = 0; i < tasks.size(); ++i) {
+        box.add(tasks[i].box);
+    }
+    return box;
+}
+
+void VertexOps::Transform(GLfloat *xyz, size_t count, const GLfloat offset[3],
+                          GLfloat scale)
+{
+    ThreadPool &pool = ThreadPool::Global();
+    if(count < _parallel_min_vertices || pool.size() <= 1) {
+        transform_block(xyz, count, offset, scale);
+        return;
+    }
+    
+    size_t per = task_size(count, pool.size() * 4);
+    std::vector<TransformTask> tasks((count + per - 1) / per);
+    std::vector<Task *> batch;
+    for(size_t i = 0; i < tasks.size(); ++i) {
+        size_t first = i * per;
+        tasks[i].xyz = xyz + first * 3;
+        tasks[i].count = (count - first < per ? count - first : per);
+        tasks[i].offset = offset;
+        tasks[i].scale = scale;
+        batch.push_back(&(tasks[i]));
+    }
+    pool.run(batch);
+}
@@ -0,0 +1,378 @@
+/**
+ * VrmlParser:
+ * Reads the face sets of a VRML file a buffer at a time. Tokens are scanned
+ * in place in the buffer, and numbers converted by the NumberParser; when a
+ * token runs off the end of the buffer it's moved to the start and the
+ * buffer refilled behind it.
+ */
+
+#include "generic/VrmlParser.hpp"
+
+#include "generic/NumberParser.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace cs354;
+
+#define RuntimeError(msg) std::runtime_error(std::string(msg))
+
+/* Big enough that refills are rare, and far longer than any token */
+static const size_t _buffer_size = 64 * 1024;
+static const char _invalid_syntax[] = "Invalid Syntax in VRML file.";
+
+static inline bool is_delimiter(char c) {
+    switch(c) {
+    case ' ': case '\t': case '\r': case '\n': case '\v': case '\f':
+    case ',': case '#': case '"':
+    case '{': case '}': case '[': case ']':
+        return true;
+    default:
+        return false;
+    }
+}
+static inline bool is_word(const char *begin, const char *end,
+                           const char *word)
+{
+    size_t len = size_t(end - begin);
+    return (std::strlen(word) == len && std::memcmp(begin, word, len) == 0);
+}
+
+/**************************************************/
+VrmlFaceSet::VrmlFaceSet() :
+    faces(0)
+{ }
+
+/**************************************************/
+VrmlParser::VrmlParser() :
+    fp(NULL), token(NULL), pos(NULL), end(NULL), eof(true), lineno(0),
+    consumed(0), hasDefName(false), nextNode(NODE_OTHER)
+{ }
+VrmlParser::~VrmlParser() {
+    close();
+}
+
+bool VrmlParser::open(const char *fname) {
+    close();
+    fp = fopen(fname, "rb");
+    if(fp == NULL) {
+        return false;
+    }
+    buffer.resize(_buffer_size);
+    token = pos = end = &(buffer[0]);
+    eof = false;
+    lineno = 1;
+    consumed = 0;
+    return true;
+}
+
+void VrmlParser::close() {
+    if(fp != NULL) {
+        fclose(fp);
+    }
+    fp = NULL;
+    token = pos = end = NULL;
+    eof = true;
+    nodes.clear();
+    defName.clear();
+    hasDefName = false;
+    nextNode = NODE_OTHER;
+}
+
+bool VrmlParser::next(VrmlFaceSet &set) {
+    set.name.clear();
+    set.coordIndex.clear();
+    set.faces = 0;
+    if(fp == NULL) {
+        return false;
+    }
+    
+    for(;;) {
+        TokenType type = scan();
+        NodeType inside = (nodes.empty() ? NODE_OTHER : nodes.back().type);
+        switch(type) {
+        case TOKEN_END:
+            if(!nodes.empty()) {
+                error("unexpected end of file");
+            }
+            return false;
+        case TOKEN_WORD:
+            if(is_word(token, pos, "DEF")) {
+                if(scan() != TOKEN_WORD) {
+                    error("expected a name after DEF");
+                }
+                defName.assign(token, pos);
+                hasDefName = true;
+            }else if(is_word(token, pos, "USE")) {
+                if(scan() != TOKEN_WORD) {
+                    error("expected a name after USE");
+                }
+                nextNode = NODE_OTHER;
+            }else if(inside == NODE_COORDINATE &&
+                     is_word(token, pos, "point"))
+            {
+                read_points(set.points);
+            }else if(inside == NODE_FACE_SET &&
+                     is_word(token, pos, "coordIndex"))
+            {
+                read_indices(set.coordIndex, set.faces);
+            }else if(is_word(token, pos, "Coordinate") ||
+                     is_word(token, pos, "Coordinate3"))
+            {
+                nextNode = NODE_COORDINATE;
+            }else if(is_word(token, pos, "IndexedFaceSet")) {
+                nextNode = NODE_FACE_SET;
+            }else {
+                nextNode = NODE_OTHER;
+            }
+            break;
+        case TOKEN_OPEN_BRACE:
+            nodes.push_back(Node());
+            nodes.back().type = nextNode;
+            if(hasDefName) {
+                nodes.back().name.swap(defName);
+            }
+            if(nextNode == NODE_FACE_SET) {
+                /* Named after the closest node with a name, often the
+                 * Shape or Transform around it */
+                for(size_t n = nodes.size(); n > 0; --n) {
+                    if(!nodes[n - 1].name.empty()) {
+                        set.name = nodes[n - 1].name;
+                        break;
+                    }
+                }
+                set.coordIndex.clear();
+                set.faces = 0;
+            }
+            hasDefName = false;
+            nextNode = NODE_OTHER;
+            break;
+        case TOKEN_CLOSE_BRACE:
+            if(nodes.empty()) {
+                error("unmatched '}'");
+            }
+            nodes.pop_back();
+            if(inside == NODE_FACE_SET) {
+                finish_face_set(set);
+                if(set.faces > 0) {
+                    return true;
+                }
+            }
+            break;
+        default:
+            /* Strings and the brackets of fields that aren't read */
+            break;
+        }
+    }
+}
+
+int VrmlParser::line() const {
+    return lineno;
+}
+
+size_t VrmlParser::bytesRead() const {
+    return consumed;
+}
+
+/* Private methods of VrmlParser */
+VrmlParser::TokenType VrmlParser::scan() {
+    /* Whitespace, commas and comments separate tokens */
+    for(;;) {
+        if(pos == end) {
+            token = pos;
+            if(!refill()) {
+                return TOKEN_END;
+            }
+        }
+        char c = *pos;
+        if(c == '\n') {
+            lineno += 1;
+            pos++;
+        }else if(c == ' ' || c == '\t' || c == '\r' || c == ',' ||
+                 c == '\v' || c == '\f')
+        {
+            pos++;
+        }else if(c == '#') {
+            const void *nl;
+            while((nl = memchr(pos, '\n', end - pos)) == NULL) {
+                token = pos = end;
+                if(!refill()) {
+                    return TOKEN_END;
+                }
+            }
+            pos = static_cast<const char *>(nl);
+        }else {
+            break;
+        }
+    }
+    
+    token = pos;
+    switch(*pos) {
+    case '{':
+        pos++;
+        return TOKEN_OPEN_BRACE;
+    case '}':
+        pos++;
+        return TOKEN_CLOSE_BRACE;
+    case '[':
+        pos++;
+        return TOKEN_OPEN_BRACKET;
+    case ']':
+        pos++;
+        return TOKEN_CLOSE_BRACKET;
+    case '"':
+        pos++;
+        for(;;) {
+            while(pos < end && *pos != '"') {
+                if(*pos == '\\') {
+                    /* The escaped character may be in the next buffer */
+                    if(pos + 1 == end) {
+                        break;
+                    }
+                    pos++;
+                }else if(*pos == '\n') {
+                    lineno += 1;
+                }
+                pos++;
+            }
+            if(pos < end && *pos == '"') {
+                break;
+            }
+            /* Strings aren't used, so they can be longer than the buffer */
+            token = pos;
+            if(!refill()) {
+                error("unterminated string");
+            }
+        }
+        pos++;
+        return TOKEN_STRING;
+    default:
+        for(;;) {
+            while(pos < end && !is_delimiter(*pos)) {
+                pos++;
+            }
+            if(pos < end || !refill()) {
+                break;
+            }
+        }
+        return TOKEN_WORD;
+    }
+}
+
+bool VrmlParser::refill() {
+    if(eof) {
+        return false;
+    }
+    size_t keep = size_t(end - token);
+    size_t offset = size_t(pos - token);
+    if(keep == buffer.size()) {
+        error("token too long");
+    }
+    char *base = &(buffer[0]);
+    memmove(base, token, keep);
+    size_t got = fread(base + keep, 1, buffer.size() - keep, fp);
+    if(got == 0 && ferror(fp)) {
+        error("could not read the file");
+    }
+    consumed += got;
+    token = base;
+    pos = base + offset;
+    end = base + keep + got;
+    eof = (got == 0);
+    return !eof;
+}
+
+/* Numbers are usually in the NumberParser's format; anything else it
+ * rejects, like ".5", is given to strtof */
+static bool parse_float(const char *begin, const char *end, float &val) {
+    if(NumberParser::Float(begin, end, val) == end) {
+        return true;
+    }
+    char text[64];
+    size_t len = size_t(end - begin);
+    if(len >= sizeof(text)) {
+        return false;
+    }
+    memcpy(text, begin, len);
+    text[len] = '\0';
+    char *stop;
+    val = strtof(text, &stop);
+    return (stop == text + len && len > 0);
+}
+
+void VrmlParser::read_points(std::vector<float> &points) {
+    points.clear();
+    TokenType type = scan();
+    bool list = (type == TOKEN_OPEN_BRACKET);
+    if(list) {
+        type = scan();
+    }
+    /* Without brackets, there's one point */
+    while(type == TOKEN_WORD) {
+        float val;
+        if(!parse_float(token, pos, val)) {
+            error("invalid number");
+        }
+        points.push_back(val);
+        if(!list && points.size() == 3) {
+            break;
+        }
+        type = scan();
+    }
+    if(list ? type != TOKEN_CLOSE_BRACKET : points.size() != 3) {
+        error("expected a list of points");
+    }
+    if(points.size() % 3 != 0) {
+        error("points need three coordinates");
+    }
+}
+
+void VrmlParser::read_indices(std::vector<int> &indices, size_t &faces) {
+    indices.clear();
+    faces = 0;
+    TokenType type = scan();
+    bool list = (type == TOKEN_OPEN_BRACKET);
+    if(list) {
+        type = scan();
+    }
+    while(type == TOKEN_WORD) {
+        int val;
+        if(NumberParser::Int(token, pos, val) != pos || val < -1) {
+            error("invalid index");
+        }
+        indices.push_back(val);
+        if(val == -1) {
+            faces += 1;
+        }
+        if(!list) {
+            break;
+        }
+        type = scan();
+    }
+    if(list ? type != TOKEN_CLOSE_BRACKET : indices.empty()) {
+        error("expected a list of indices");
+    }
+    /* The last face doesn't need its -1 */
+    if(!indices.empty() && indices.back() != -1) {
+        indices.push_back(-1);
+        faces += 1;
+    }
+}
+
+void VrmlParser::finish_face_set(VrmlFaceSet &set) {
+    int npoints = int(set.points.size() / 3);
+    for(size_t i = 0; i < set.coordIndex.size(); ++i) {
+        if(set.coordIndex[i] >= npoints) {
+            error("coordIndex past the end of the points");
+        }
+    }
+}
+
+void VrmlParser::error(const char *what) const {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%s (line %d: %s)", _invalid_syntax, lineno,
+             what);
+    throw RuntimeError(msg);
+}
+/**************************************************/
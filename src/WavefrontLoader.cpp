@@ -1,7 +1,17 @@
 
 #include "generic/WavefrontLoader.hpp"
+#include "generic/ElementIndex.hpp"
+#include "generic/MappedFile.hpp"
+#include "generic/MaterialLibrary.hpp"
 #include "generic/Model.hpp"
+#include "generic/ModelCache.hpp"
+#include "generic/ModelFuture.hpp"
+#include "generic/NumberParser.hpp"
+#include "generic/ThreadPool.hpp"
+#include "generic/VertexCache.hpp"
+#include "generic/VertexOps.hpp"
 
+#include <algorithm>
 #include <cfloat>
 #include <climits>
 #include <cstdarg>
@@ -13,41 +23,324 @@
 using namespace cs354;
 
 /**************************************************/
-/* Symbols from the bison generated parsers */
-extern int wf_parse(void);
-extern void wf_restart(FILE *fp);
-extern int mat_parse(void);
-extern void mat_restart(FILE *fp);
-/**************************************************/
-/* Symbols for the bison generated parsers */
-WavefrontLoader * cs354::loader;
+/* Symbols from the bison and flex generated parsers. The scanners are
+ * re-entrant, so their state is an opaque pointer (yyscan_t) rather than a
+ * pile of globals. */
+extern int wf_parse(void *scanner, WavefrontLoader *loader);
+extern int wf_lex_init(void **scanner);
+extern int wf_lex_destroy(void *scanner);
+extern void wf_set_in(FILE *fp, void *scanner);
 /**************************************************/
 /* Defines to make my life easier */
 #define RuntimeError(msg) std::runtime_error(std::string(msg))
+/* Messages above CS354_LOG_LEVEL compile to nothing */
+#define LOADER_LOG(level, ...) \
+    do { \
+        if((level) <= CS354_LOG_LEVEL) { \
+            log((level), __VA_ARGS__); \
+        } \
+    } while(0)
 
-static const char _inv_mat_ref[] =
-    "Attempt to set %s without material reference.\n";
+static const char _invalid_syntax[] =
+    "Invalid Syntax in wavefront .obj file.";
 /**************************************************/
 
 /**************************************************/
-LoaderMatGroup::LoaderMatGroup() { }
-LoaderMatGroup::LoaderMatGroup(const std::string &mtlname) :
-    mtlname(mtlname)
+/* Hand-written .obj tokenizer.
+ * This works directly on the mapped file and hands each statement to the
+ * same parser interface the bison grammar uses. Numbers are converted in
+ * place by the NumberParser; only names are copied.
+ */
+static inline bool is_blank(char c) {
+    return (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f');
+}
+static inline bool is_digit(char c) {
+    return (c >= '0' && c <= '9');
+}
+static inline const char * skip_blanks(const char *pos, const char *end) {
+    while(pos < end && is_blank(*pos)) {
+        pos++;
+    }
+    return pos;
+}
+static inline const char * skip_word(const char *pos, const char *end) {
+    while(pos < end && *pos != '\n' && !is_blank(*pos)) {
+        pos++;
+    }
+    return pos;
+}
+static inline const char * skip_line(const char *pos, const char *end) {
+    const char *nl = (const char *)memchr(pos, '\n', end - pos);
+    return (nl == NULL ? end : nl + 1);
+}
+static inline bool at_eol(const char *pos, const char *end) {
+    return (pos >= end || *pos == '\n' || *pos == '#');
+}
+static inline bool keyword(const char *word, size_t len, const char *kw) {
+    return (std::strlen(kw) == len && std::memcmp(word, kw, len) == 0);
+}
+
+/* Thrown by the tokenizer. The line is relative to the start of the range
+ * being tokenized, which may not be the start of the file. */
+struct ObjSyntaxError {
+    ObjSyntaxError(int line, const char *what) :
+        line(line), what(what)
+    { }
+    int line;
+    const char *what;
+};
+static void syntax_error(int lineno, const char *what) {
+    throw ObjSyntaxError(lineno, what);
+}
+static std::runtime_error syntax_exception(int lineno, const char *what) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%s (line %d: %s)", _invalid_syntax, lineno,
+             what);
+    return RuntimeError(msg);
+}
+
+/* Up to three floats, missing values are 0.0 */
+static const char * scan_triple(const char *pos, const char *end,
+                                GLfloat coords[3], int lineno)
+{
+    coords[0] = coords[1] = coords[2] = 0.0f;
+    for(int i = 0; i < 3; ++i) {
+        pos = skip_blanks(pos, end);
+        if(at_eol(pos, end)) {
+            if(i == 0) {
+                syntax_error(lineno, "expected a number");
+            }
+            break;
+        }
+        pos = NumberParser::Float(pos, end, coords[i]);
+        if(pos == NULL) {
+            syntax_error(lineno, "invalid number");
+        }
+    }
+    return pos;
+}
+
+/* Tokenizes the range [pos, end) and feeds each statement to the sink. The
+ * sink needs the same v/vn/vt/fArg/f/o/g/usemtl/mtllib interface as the
+ * WavefrontLoader, and 'lineno' is kept up to date for its error messages.
+ */
+template <typename Sink>
+static void tokenize_obj(const char *pos, const char *end, Sink &sink,
+                         int &lineno)
+{
+    GLfloat coords[3];
+    int args[3];
+    std::string name;
+    
+    while(pos < end) {
+        lineno += 1;
+        pos = skip_blanks(pos, end);
+        if(at_eol(pos, end)) {
+            pos = skip_line(pos, end);
+            continue;
+        }
+        
+        const char *word = pos;
+        pos = skip_word(pos, end);
+        size_t len = pos - word;
+        
+        if(keyword(word, len, "v")) {
+            pos = scan_triple(pos, end, coords, lineno);
+            sink.v(coords);
+        }else if(keyword(word, len, "vn")) {
+            pos = scan_triple(pos, end, coords, lineno);
+            sink.vn(coords);
+        }else if(keyword(word, len, "vt")) {
+            pos = scan_triple(pos, end, coords, lineno);
+            sink.vt(coords);
+        }else if(keyword(word, len, "f")) {
+            for(;;) {
+                pos = skip_blanks(pos, end);
+                if(at_eol(pos, end)) {
+                    break;
+                }
+                pos = NumberParser::Face(pos, end, args);
+                if(pos == NULL) {
+                    syntax_error(lineno, "invalid face element");
+                }
+                sink.fArg(args);
+            }
+            sink.f();
+        }else if(keyword(word, len, "o") || keyword(word, len, "g") ||
+                 keyword(word, len, "usemtl") || keyword(word, len, "mtllib"))
+        {
+            pos = skip_blanks(pos, end);
+            const char *start = pos;
+            pos = skip_word(pos, end);
+            if(pos == start) {
+                syntax_error(lineno, "expected a name");
+            }
+            name.assign(start, pos - start);
+            switch(word[0]) {
+            case 'o':
+                sink.o(name.c_str());
+                break;
+            case 'g':
+                sink.g(name.c_str());
+                break;
+            case 'u':
+                sink.usemtl(name.c_str());
+                break;
+            default:
+                sink.mtllib(name.c_str());
+                break;
+            }
+        }else if(!keyword(word, len, "s")) {
+            /* Smoothing groups are ignored, anything else is an error */
+            syntax_error(lineno, "unknown statement");
+        }
+        
+        pos = skip_line(pos, end);
+    }
+}
+
+/* Parallel parsing of large files.
+ * The file is split at line boundaries and each chunk is tokenized into an
+ * ObjChunk on the thread pool. Chunks can't resolve relative indices or
+ * track the current object/group/material, since both depend on everything
+ * before them in the file. Instead they keep their own vertex lists, turn
+ * relative indices into chunk-local ones, and record o/g/usemtl/mtllib/f
+ * statements in order. The loader then merges the chunks in file order,
+ * replaying the records exactly as a sequential parse would have.
+ */
+static const size_t _parallel_min_size = 1 << 20;
+static const size_t _parallel_chunk_size = 1 << 18;
+
+namespace cs354 {
+struct ObjRecord {
+    enum Type { FACE, OBJECT, GROUP, USEMTL, MTLLIB };
+    Type type;
+    /* Element count for faces, index into ObjChunk::names otherwise */
+    size_t arg;
+    int line;
+};
+
+class ObjChunk : public Task {
+public:
+    /* Bits in ObjChunk::relative, set when the matching index of an element
+     * was relative and has been made chunk-local. */
+    enum { REL_V = 1, REL_VT = 2, REL_VN = 4 };
+    
+    ObjChunk(const char *begin, const char *end) :
+        begin(begin), end(end), lines(0), pending(0), failed(false),
+        errline(0), errwhat(NULL)
+    { }
+    
+    void run() {
+        try {
+            tokenize_obj(begin, end, *this, lines);
+        }catch(ObjSyntaxError &err) {
+            failed = true;
+            errline = err.line;
+            errwhat = err.what;
+        }
+    }
+    
+    /* Tokenizer sink */
+    void v(GLfloat coords[3]) {
+        vertices.push_back(Vertex(coords));
+    }
+    void vn(GLfloat coords[3]) {
+        normals.push_back(Normal(coords));
+    }
+    void vt(GLfloat coords[3]) {
+        texCoords.push_back(TextureCoord(coords));
+    }
+    void fArg(int args[3]) {
+        unsigned char rel = 0;
+        if(args[0] < 0) {
+            args[0] += int(vertices.size());
+            rel |= REL_V;
+        }
+        if(args[1] < 0) {
+            args[1] += int(texCoords.size());
+            rel |= REL_VT;
+        }
+        if(args[2] < 0) {
+            args[2] += int(normals.size());
+            rel |= REL_VN;
+        }
+        elements.push_back(Element(args));
+        relative.push_back(rel);
+        pending += 1;
+    }
+    void f() {
+        record(ObjRecord::FACE, pending);
+        pending = 0;
+    }
+    void o(const char *name) {
+        named(ObjRecord::OBJECT, name);
+    }
+    void g(const char *name) {
+        named(ObjRecord::GROUP, name);
+    }
+    void usemtl(const char *name) {
+        named(ObjRecord::USEMTL, name);
+    }
+    void mtllib(const char *name) {
+        named(ObjRecord::MTLLIB, name);
+    }
+    
+    const char *begin, *end;
+    int lines;
+    std::vector<Vertex> vertices;
+    std::vector<TextureCoord> texCoords;
+    std::vector<Normal> normals;
+    std::vector<Element> elements;
+    std::vector<unsigned char> relative;
+    std::vector<ObjRecord> records;
+    std::vector<std::string> names;
+    size_t pending;
+    
+    bool failed;
+    int errline;
+    const char *errwhat;
+private:
+    void record(ObjRecord::Type type, size_t arg) {
+        ObjRecord rec = { type, arg, lines };
+        records.push_back(rec);
+    }
+    void named(ObjRecord::Type type, const char *name) {
+        record(type, names.size());
+        names.push_back(std::string(name));
+    }
+};
+}
+/**************************************************/
+
+/**************************************************/
+/* current is set to this until the first face */
+static const size_t _no_entry = ~size_t(0);
+
+LoaderMatGroup::LoaderMatGroup() :
+    name(SymbolTable::None)
+{ }
+LoaderMatGroup::LoaderMatGroup(Symbol name) :
+    name(name)
 { }
 LoaderMatGroup::~LoaderMatGroup() { }
 /**************************************************/
 
 /**************************************************/
-LoaderGroup::LoaderGroup() { }
-LoaderGroup::LoaderGroup(const std::string &name) :
+LoaderGroup::LoaderGroup() :
+    name(SymbolTable::None)
+{ }
+LoaderGroup::LoaderGroup(Symbol name) :
     name(name)
 { }
 LoaderGroup::~LoaderGroup() { }
 /**************************************************/
 
 /**************************************************/
-LoaderObject::LoaderObject() { }
-LoaderObject::LoaderObject(const std::string &name) :
+LoaderObject::LoaderObject() :
+    name(SymbolTable::None)
+{ }
+LoaderObject::LoaderObject(Symbol name) :
     name(name)
 { }
 LoaderObject::~LoaderObject() { }
@@ -55,54 +348,96 @@ LoaderObject::~LoaderObject() { }
 
 /**************************************************/
 WavefrontLoader::WavefrontLoader(bool keep_materials, bool global_mats) :
-    logFile(stderr), keepMaterials(keep_materials),
-    globalMaterials(global_mats)
+    parserType(PARSER_MMAP), cacheEnabled(true), optimizeEnabled(false),
+    lineno(0), logFile(stderr),
+    verbosity(LOG_INFO), globalMaterialMap(NULL),
+    keepMaterials(keep_materials), globalMaterials(global_mats)
 { }
 WavefrontLoader::~WavefrontLoader() { }
 
+/* Cache keys for each of the load() variants */
+static CacheKey load_key(unsigned int flags, Vertex origin, GLfloat max_dim) {
+    CacheKey key;
+    key.flags = flags;
+    if(flags & ModelCache::TRANSLATED) {
+        key.origin[0] = origin.x;
+        key.origin[1] = origin.y;
+        key.origin[2] = origin.z;
+    }
+    if(flags & ModelCache::SCALED) {
+        key.max_dim = max_dim;
+    }
+    return key;
+}
+static const Vertex _no_origin(0.0f, 0.0f, 0.0f);
+
 Model * WavefrontLoader::load(const char *fname) {
-    loader = this;
-    parse(fname);
-    return cache_to_model();
+    return load(fname, load_key(0, _no_origin, 0.0f));
 }
 Model * WavefrontLoader::load(const char *fname, GLfloat max_dim) {
-    loader = this;
-    parse(fname);
-    scale(max_dim);
-    return cache_to_model();
+    return load(fname, load_key(ModelCache::SCALED, _no_origin, max_dim));
 }
 Model * WavefrontLoader::load(const char *fname, Vertex origin) {
-    loader = this;
-    parse(fname);
-    translate(origin);
-    return cache_to_model();
+    return load(fname, load_key(ModelCache::TRANSLATED, origin, 0.0f));
 }
 Model * WavefrontLoader::load(const char *fname, Vertex origin,
                               GLfloat max_dim)
 {
-    loader = this;
-    parse(fname);
-    translate(origin);
-    scale(max_dim);
-    return cache_to_model();
+    return load(fname, load_key(ModelCache::TRANSLATED | ModelCache::SCALED,
+                                origin, max_dim));
+}
+
+ModelFuture * WavefrontLoader::loadAsync(const char *fname) {
+    return new ModelFuture(this, fname, load_key(0, _no_origin, 0.0f));
+}
+ModelFuture * WavefrontLoader::loadAsync(const char *fname, GLfloat max_dim) {
+    return new ModelFuture(this, fname,
+                           load_key(ModelCache::SCALED, _no_origin, max_dim));
+}
+ModelFuture * WavefrontLoader::loadAsync(const char *fname, Vertex origin) {
+    return new ModelFuture(this, fname,
+                           load_key(ModelCache::TRANSLATED, origin, 0.0f));
+}
+ModelFuture * WavefrontLoader::loadAsync(const char *fname, Vertex origin,
+                                         GLfloat max_dim)
+{
+    return new ModelFuture(this, fname,
+                           load_key(ModelCache::TRANSLATED |
+                                    ModelCache::SCALED, origin, max_dim));
 }
 
 void WavefrontLoader::use(std::map<std::string, Material> & global_mat_map) {
     globalMaterialMap = &global_mat_map;
 }
+void WavefrontLoader::useParser(ParserType type) {
+    parserType = type;
+}
+void WavefrontLoader::useCache(bool enable) {
+    cacheEnabled = enable;
+}
+void WavefrontLoader::useOptimizer(bool enable) {
+    optimizeEnabled = enable;
+}
+void WavefrontLoader::useLogLevel(LogLevel level) {
+    verbosity = level;
+}
+
+LoaderStats & WavefrontLoader::stats() {
+    return loadStats;
+}
+const LoaderStats & WavefrontLoader::stats() const {
+    return loadStats;
+}
 
 /**************************************************/
 /* Parser interface */
 
+void WavefrontLoader::line(int lineno) {
+    this->lineno = lineno;
+}
+
 void WavefrontLoader::v(GLfloat coords[3]) {
     vertices.push_back(Vertex(coords));
-    /* Update stats for scale/transform if requested */
-    max.x = (coords[0] > max.x ? coords[0] : max.x);
-    min.x = (coords[0] < min.x ? coords[0] : min.x);
-    max.y = (coords[1] > max.y ? coords[1] : max.y);
-    min.y = (coords[1] < min.y ? coords[1] : min.y);
-    max.z = (coords[2] > max.z ? coords[2] : max.z);
-    min.z = (coords[2] < min.z ? coords[2] : min.z);
 }
 void WavefrontLoader::vn(GLfloat coords[3]) {
     normals.push_back(Normal(coords));
@@ -110,38 +445,47 @@ void WavefrontLoader::vn(GLfloat coords[3]) {
 void WavefrontLoader::vt(GLfloat coords[3]) {
     texCoords.push_back(TextureCoord(coords));
 }
-extern int wf_lineno;
 void WavefrontLoader::f() {
+    size_t fs_size = faceStack.size();
+    if(fs_size >= 3) {
+        for(size_t i = 0; i < fs_size; ++i) {
+            resolve(faceStack[i]);
+        }
+    }
+    push_face();
+}
+void WavefrontLoader::push_face() {
     /* Resolve any outstanding object, group or material requests */
-    if(current.object == NULL || next.hasObject) {
+    if(current.object == _no_entry || next.hasObject) {
         newObject(next.object);
-    }else if(current.group == NULL || next.hasGroup) {
+    }else if(current.group == _no_entry || next.hasGroup) {
         newGroup(next.group);
-    }else if(current.mgroup == NULL || next.hasMtl) {
+    }else if(current.mgroup == _no_entry || next.hasMtl) {
         newMatGroup(next.mtl);
     }
     
     size_t fs_size = faceStack.size();
     if(fs_size < 3) {
-        log("Error on line %d: Too few arguments to f [%d]\n", wf_lineno,
-            int(fs_size));
+        LOADER_LOG(LOG_WARN,
+                   "Error on line %d: Too few arguments to f [%d]\n", lineno,
+                   int(fs_size));
+        faceStack.clear();
         return;
     }
     
-    resolve(faceStack[0]);
-    resolve(faceStack[1]);
-    resolve(faceStack[2]);
+    /* Elements have already been resolved, just triangulate */
+    std::vector<Triangle> &faces = matGroups[current.mgroup].faces;
     Triangle t = { faceStack[0], faceStack[1], faceStack[2] };
-    current.mgroup->faces.push_back(t);
+    faces.push_back(t);
     for(size_t i = 3; i < fs_size; ++i) {
-        resolve(faceStack[i]);
         t.v2 = t.v3;
         t.v3 = faceStack[i];
-        current.mgroup->faces.push_back(t);
+        faces.push_back(t);
     }
     
     if(fs_size > 3) {
-        log("face tesselated into %llu triangles\n", fs_size - 2);
+        LOADER_LOG(LOG_DEBUG, "face tesselated into %llu triangles\n",
+                   (unsigned long long)(fs_size - 2));
     }
     faceStack.clear();
 }
@@ -149,152 +493,124 @@ void WavefrontLoader::fArg(int args[3]) {
     faceStack.push_back(Element(args));
 }
 void WavefrontLoader::mtllib(const char *lib) {
-    /* Here is the fun part, we call a new parser from within another parser */
-    libname = basename + std::string("/") + std::string(lib);
-    FILE *libfp = fopen(libname.c_str(), "r");
-    if(!libfp) {
-        log("Could not open mtllib %s\n", libname.c_str());
-        return;
-    }
+    std::string libname = basename + std::string("/") + std::string(lib);
+    /* Missing libraries are recorded too; the cache is stale if they appear */
+    libraries.push_back(libname);
     
-    mat_restart(libfp);
-    int rval;
+    /* Libraries are shared between loaders, and only parsed the first time
+     * any of them asks for one */
+    const MaterialLibrary *library;
     try {
-        rval = mat_parse();
+        library = MaterialLibrary::Load(libname);
     }catch(std::exception &e) {
-        log("Could not parse %s; %s\n", libname.c_str(), e.what());
-        fclose(libfp);
-        throw e;
+        LOADER_LOG(LOG_ERROR, "Could not parse %s; %s\n", libname.c_str(),
+                   e.what());
+        throw;
     }
-    
-    fclose(libfp);
-    
-    if(mat.valid) {
-        materials[mat.name] = mat.def;
+    if(library == NULL) {
+        LOADER_LOG(LOG_WARN, "Could not open mtllib %s\n", libname.c_str());
+        return;
     }
     
-    switch(rval) {
-    case 0:
-        break;
-    case 1:
-        log("Syntax error while parsing %s\n", libname.c_str());
-        throw RuntimeError("Syntax Error");
-    case 2:
-        log("Material parser exhausted memory while parsing %s\n",
-            libname.c_str());
-        throw RuntimeError("Parser exhausted memory");
-    default:
-        log("Unknown error parsing %s\n", libname.c_str());
-        throw RuntimeError("Unknown Error");
+    typedef std::map<std::string, Material>::const_iterator lib_iter;
+    const std::map<std::string, Material> &defs = library->materials();
+    for(lib_iter iter = defs.begin(); iter != defs.end(); ++iter) {
+        const Material *&mat = materials[iter->first];
+        if(mat != NULL && mat != &(iter->second)) {
+            LOADER_LOG(LOG_WARN, "Redefinition of material \"%s\"\n",
+                       iter->first.c_str());
+        }
+        mat = &(iter->second);
     }
 }
 void WavefrontLoader::usemtl(const char *mtlname) {
     if(next.hasMtl) {
-        log("Multiple Material definition: Overwriting \"%s\" with \"%s\"\n",
-            next.mtl.c_str(), mtlname);
+        LOADER_LOG(LOG_WARN, "Multiple Material definition: "
+                   "Overwriting \"%s\" with \"%s\"\n",
+                   symbols.name(next.mtl).c_str(), mtlname);
     }
     
-    next.mtl = mtlname;
+    next.mtl = symbols.intern(mtlname, std::strlen(mtlname));
     next.hasMtl = true;
 }
 void WavefrontLoader::g(const char *groupname) {
     if(next.hasGroup) {
-        log("Multiple Group definition: Overwriting \"%s\" with \"%s\"\n",
-            next.group.c_str(), groupname);
+        LOADER_LOG(LOG_WARN, "Multiple Group definition: "
+                   "Overwriting \"%s\" with \"%s\"\n",
+                   symbols.name(next.group).c_str(), groupname);
     }
     
-    next.group = groupname;
+    next.group = symbols.intern(groupname, std::strlen(groupname));
     next.hasGroup = true;
 }
 void WavefrontLoader::o(const char *objectname) {
     if(next.hasObject) {
-        log("Multiple Object definition: Overwriting \"%\" with \"%s\"\n",
-            next.object.c_str(), objectname);
+        LOADER_LOG(LOG_WARN, "Multiple Object definition: "
+                   "Overwriting \"%s\" with \"%s\"\n",
+                   symbols.name(next.object).c_str(), objectname);
     }
     
-    next.object = objectname;
+    next.object = symbols.intern(objectname, std::strlen(objectname));
     next.hasObject = true;
 }
 
-/* Material commands */
-void WavefrontLoader::newmtl(const char *mtlname) {
-    if(mat.valid) {
-        materials[mat.name] = mat.def;
-    }
-    
-    /* Set the new name, then make sure that the material hasn't already been
-     * defined. */
-    mat.name = mtlname;
+/**************************************************/
+/* Private methods of WavefrontLoader */
+Model * WavefrontLoader::load(const char *file_name,
+                              const CacheKey &request)
+{
+    double start = LoaderStats::Now();
+    loadStats.reset();
+    loadStats.file = file_name;
     
-    if(materials.find(mat.name) != materials.end()) {
-        log("Redefinition of material \"%s\"\n", mtlname);
-        mat.def = materials[mat.name];
-    }else if(globalMaterialMap != NULL && globalMaterials &&
-             globalMaterialMap->find(mat.name) != globalMaterialMap->end())
-    {
-        log("Redefinition of material \"%s\"in global material map.\n",
-            mtlname);
-        mat.def = globalMaterialMap->find(mat.name)->second;
-    }else {
-        mat.def = Material::Default;
-    }
-    mat.valid = true;
-}
-
-void WavefrontLoader::ka(GLfloat color[3]) {
-    if(mat.valid) {
-        mat.def.ka[0] = color[0];
-        mat.def.ka[1] = color[1];
-        mat.def.ka[2] = color[2];
-    }else {
-        log(_inv_mat_ref, "Ka");
-    }
-}
-void WavefrontLoader::kd(GLfloat color[3]) {
-    if(mat.valid) {
-        mat.def.kd[0] = color[0];
-        mat.def.kd[1] = color[1];
-        mat.def.kd[2] = color[2];
-    }else {
-        log(_inv_mat_ref, "Kd");
-    }
-}
-void WavefrontLoader::ks(GLfloat color[3]) {
-    if(mat.valid) {
-        mat.def.ks[0] = color[0];
-        mat.def.ks[1] = color[1];
-        mat.def.ks[2] = color[2];
-    }else {
-        log(_inv_mat_ref, "Ks");
+    CacheKey key = request;
+    if(optimizeEnabled) {
+        key.flags |= ModelCache::OPTIMIZED;
     }
-}
-void WavefrontLoader::ns(GLfloat amount) {
-    if(mat.valid) {
-        mat.def.ns = amount;
-    }else {
-        log(_inv_mat_ref, "Ns");
+    
+    bool cacheable = cacheEnabled && !keepMaterials &&
+                     !(globalMaterials && globalMaterialMap != NULL);
+    Model *model = NULL;
+    if(cacheable) {
+        PhaseTimer timer(loadStats, LoaderStats::CACHE);
+        model = ModelCache::Load(file_name, key);
     }
-}
-void WavefrontLoader::tr(GLfloat amount) {
-    if(mat.valid) {
-        mat.def.tr = amount;
+    if(model != NULL) {
+        LOADER_LOG(LOG_INFO, "Loaded %s from %s\n", file_name,
+                   ModelCache::Path(file_name).c_str());
+        loadStats.cached = true;
     }else {
-        log(_inv_mat_ref, "Tr");
+        parse(file_name);
+        {
+            PhaseTimer timer(loadStats, LoaderStats::TRANSFORM);
+            transform(key);
+        }
+        {
+            PhaseTimer timer(loadStats, LoaderStats::DEDUP);
+            model = cache_to_model();
+        }
+        if(key.flags & ModelCache::OPTIMIZED) {
+            PhaseTimer timer(loadStats, LoaderStats::OPTIMIZE);
+            optimize(model);
+        }
+        
+        /* A cache that can't be written only costs time on the next load */
+        if(cacheable) {
+            PhaseTimer timer(loadStats, LoaderStats::CACHE);
+            if(!ModelCache::Save(file_name, *model, key, libraries)) {
+                LOADER_LOG(LOG_WARN, "Could not write %s\n",
+                           ModelCache::Path(file_name).c_str());
+            }
+        }
     }
+    
+    count(model);
+    loadStats.total = LoaderStats::Now() - start;
+    return model;
 }
-
-/**************************************************/
-/* Private methods of WavefrontLoader */
 void WavefrontLoader::parse(const char *file_name) {
-    int rval;
     clear();
     
-    FILE *fp = fopen(file_name, "r");
-    if(!fp) {
-        /* Couldn't open the file, throw an exception to abort. */
-        throw RuntimeError("Could not open file");
-    }
-    
     fname = file_name;
     size_t last_sep = fname.rfind("/");
     if(last_sep == std::string::npos) {
@@ -303,23 +619,65 @@ void WavefrontLoader::parse(const char *file_name) {
         basename = std::string(fname, 0, last_sep);
     }
     
+    if(parserType == PARSER_MMAP) {
+        MappedFile file;
+        bool mapped;
+        {
+            PhaseTimer timer(loadStats, LoaderStats::READ);
+            mapped = file.open(file_name);
+        }
+        if(mapped) {
+            parse_mmap(file.data(), file.end());
+            return;
+        }
+        LOADER_LOG(LOG_WARN,
+                   "Could not map %s; falling back to bison parser\n",
+                   file_name);
+    }
+    
+    FILE *fp;
+    {
+        PhaseTimer timer(loadStats, LoaderStats::READ);
+        fp = fopen(file_name, "r");
+    }
+    if(!fp) {
+        /* Couldn't open the file, throw an exception to abort. */
+        throw RuntimeError("Could not open file");
+    }
+    /* stdio reads as the scanner asks, so reading counts as parsing here */
+    PhaseTimer timer(loadStats, LoaderStats::PARSE);
+    parse_bison(fp);
+}
+
+void WavefrontLoader::parse_bison(FILE *fp) {
+    int rval;
+    
+    void *scanner;
+    if(wf_lex_init(&scanner) != 0) {
+        fclose(fp);
+        throw RuntimeError("Could not create scanner");
+    }
+    wf_set_in(fp, scanner);
+    
     /* Call the parser; this may throw an exception due to the wf_parse method
      * calling methods of WavefrontLoader that throw exceptions. To be safe,
      * any exceptions are caught, the file is closed, then the exception is
      * rethrown. */
-    wf_restart(fp);
     try {
-        rval = wf_parse();
+        rval = wf_parse(scanner, this);
     }catch(std::runtime_error &re) {
+        wf_lex_destroy(scanner);
         fclose(fp);
         throw re;
     }catch(std::exception &e) {
+        wf_lex_destroy(scanner);
         fclose(fp);
         throw e;
     }
     
     /* Close the file - done here so that if the parser returned an error code
      * we don't leave the file open. */
+    wf_lex_destroy(scanner);
     fclose(fp);
     
     /* Examine the return value. 0 = good, 1 = Invalid Syntax,
@@ -328,7 +686,7 @@ void WavefrontLoader::parse(const char *file_name) {
     case 0:
         break;
     case 1:
-        throw RuntimeError("Invalid Syntax in wavefront .obj file.");
+        throw RuntimeError(_invalid_syntax);
     case 2:
         throw RuntimeError("Parser exhausted memory.");
     default:
@@ -337,103 +695,366 @@ void WavefrontLoader::parse(const char *file_name) {
     }
 }
 
-void WavefrontLoader::scale(GLfloat maxdim) {
-    size_t nvertices = vertices.size();
-    if(nvertices <= 1) {
+void WavefrontLoader::parse_mmap(const char *begin, const char *end) {
+    size_t size = end - begin;
+    ThreadPool &pool = ThreadPool::Global();
+    if(size >= _parallel_min_size && pool.size() > 1) {
+        size_t nchunks = size / _parallel_chunk_size;
+        if(nchunks > pool.size() * 4) {
+            nchunks = pool.size() * 4;
+        }
+        parse_parallel(begin, end, nchunks);
         return;
     }
     
-    GLfloat diffx = max.x - min.x;
-    GLfloat diffy = max.y - min.y;
-    GLfloat diffz = max.z - min.z;
-    GLfloat maxdiff = (diffx > diffy ? diffx : diffy);
-    maxdiff = (maxdiff > diffz ? maxdiff : diffz);
-    GLfloat scalefactor = maxdim / maxdiff;
+    lineno = 0;
+    PhaseTimer timer(loadStats, LoaderStats::PARSE);
+    try {
+        tokenize_obj(begin, end, *this, lineno);
+    }catch(ObjSyntaxError &err) {
+        LOADER_LOG(LOG_ERROR, "Error near line %d: %s\n", err.line, err.what);
+        throw syntax_exception(err.line, err.what);
+    }
+}
+
+void WavefrontLoader::parse_parallel(const char *begin, const char *end,
+                                     size_t nchunks)
+{
+    size_t size = end - begin;
+    std::vector<ObjChunk *> chunks;
+    std::vector<Task *> tasks;
+    
+    /* Split the file at line boundaries */
+    const char *start = begin;
+    for(size_t i = 1; i <= nchunks && start < end; ++i) {
+        const char *stop = end;
+        if(i < nchunks) {
+            stop = begin + (size / nchunks) * i;
+            if(stop < start) {
+                stop = start;
+            }
+            stop = skip_line(stop, end);
+        }
+        chunks.push_back(new ObjChunk(start, stop));
+        tasks.push_back(chunks.back());
+        start = stop;
+    }
     
-    for(size_t i = 0; i < nvertices; ++i) {
-        /* Translate point to vector from origin, scale vector, convert back to
-         * point. */
-        vertices[i] = (vertices[i].toVector() * scalefactor).toPoint();
+    try {
+        {
+            PhaseTimer timer(loadStats, LoaderStats::PARSE);
+            ThreadPool::Global().run(tasks);
+        }
+        PhaseTimer timer(loadStats, LoaderStats::RESOLVE);
+        merge_chunks(chunks);
+    }catch(...) {
+        for(size_t i = 0; i < chunks.size(); ++i) {
+            delete chunks[i];
+        }
+        throw;
+    }
+    for(size_t i = 0; i < chunks.size(); ++i) {
+        delete chunks[i];
+    }
+}
+
+/* Resolve a single index from a chunk. Relative indices were made
+ * chunk-local by the chunk and just need its base offset; everything else is
+ * handled the same way resolve() does it. */
+static inline int resolve_chunk_index(int idx, bool relative, size_t base,
+                                      bool &invalidate)
+{
+    if(relative) {
+        return int(base) + idx;
+    }else if(idx == 0) {
+        invalidate = true;
+        return -1;
+    }
+    return idx - 1;
+}
+
+void WavefrontLoader::merge_chunks(const std::vector<ObjChunk *> &chunks) {
+    size_t nchunks = chunks.size();
+    size_t nverts = 0, ntex = 0, nnorm = 0;
+    
+    /* Report the first syntax error relative to the whole file */
+    int line_base = 0;
+    for(size_t i = 0; i < nchunks; ++i) {
+        const ObjChunk &chunk = *(chunks[i]);
+        if(chunk.failed) {
+            int errline = line_base + chunk.errline;
+            LOADER_LOG(LOG_ERROR, "Error near line %d: %s\n", errline,
+                       chunk.errwhat);
+            throw syntax_exception(errline, chunk.errwhat);
+        }
+        line_base += chunk.lines;
+        nverts += chunk.vertices.size();
+        ntex += chunk.texCoords.size();
+        nnorm += chunk.normals.size();
     }
+    vertices.reserve(nverts);
+    texCoords.reserve(ntex);
+    normals.reserve(nnorm);
     
-    max.x *= scalefactor;
-    max.y *= scalefactor;
-    max.z *= scalefactor;
-    min.x *= scalefactor;
-    min.y *= scalefactor;
-    min.z *= scalefactor;
+    line_base = 0;
+    for(size_t i = 0; i < nchunks; ++i) {
+        const ObjChunk &chunk = *(chunks[i]);
+        size_t vbase = vertices.size();
+        size_t vtbase = texCoords.size();
+        size_t vnbase = normals.size();
+        
+        /* Everything a chunk references comes either from earlier chunks or
+         * from itself, so all of its vertex data can be appended up front. */
+        vertices.insert(vertices.end(), chunk.vertices.begin(),
+                        chunk.vertices.end());
+        texCoords.insert(texCoords.end(), chunk.texCoords.begin(),
+                         chunk.texCoords.end());
+        normals.insert(normals.end(), chunk.normals.begin(),
+                       chunk.normals.end());
+        
+        size_t elem = 0;
+        size_t nrecords = chunk.records.size();
+        for(size_t r = 0; r < nrecords; ++r) {
+            const ObjRecord &rec = chunk.records[r];
+            lineno = line_base + rec.line;
+            switch(rec.type) {
+            case ObjRecord::FACE:
+                if(rec.arg < 3) {
+                    /* Not a valid face; push_face() complains and drops it */
+                    for(size_t k = 0; k < rec.arg; ++k, ++elem) {
+                        faceStack.push_back(chunk.elements[elem]);
+                    }
+                    push_face();
+                    break;
+                }
+                for(size_t k = 0; k < rec.arg; ++k, ++elem) {
+                    Element e = chunk.elements[elem];
+                    unsigned char rel = chunk.relative[elem];
+                    bool unused = false;
+                    e.v = resolve_chunk_index(e.v, rel & ObjChunk::REL_V,
+                                              vbase, unused);
+                    e.vt = resolve_chunk_index(e.vt, rel & ObjChunk::REL_VT,
+                                               vtbase, invalidate_texcoords);
+                    e.vn = resolve_chunk_index(e.vn, rel & ObjChunk::REL_VN,
+                                               vnbase, invalidate_normals);
+                    faceStack.push_back(e);
+                }
+                push_face();
+                break;
+            case ObjRecord::OBJECT:
+                o(chunk.names[rec.arg].c_str());
+                break;
+            case ObjRecord::GROUP:
+                g(chunk.names[rec.arg].c_str());
+                break;
+            case ObjRecord::USEMTL:
+                usemtl(chunk.names[rec.arg].c_str());
+                break;
+            case ObjRecord::MTLLIB:
+                mtllib(chunk.names[rec.arg].c_str());
+                break;
+            }
+        }
+        line_base += chunk.lines;
+    }
 }
-void WavefrontLoader::translate(Vertex origin) {
+
+/* transform() works on the vertex list as one packed float array */
+typedef char _vertex_is_packed[sizeof(Vertex) == 3 * sizeof(GLfloat) ? 1 : -1];
+
+void WavefrontLoader::transform(const CacheKey &key) {
     size_t nvertices = vertices.size();
-    if(nvertices <= 1) {
+    bool translate = (key.flags & ModelCache::TRANSLATED) != 0;
+    bool scale = (key.flags & ModelCache::SCALED) != 0;
+    if(nvertices <= 1 || !(translate || scale)) {
+        return;
+    }
+    
+    /* Vertices are packed xyz triples */
+    GLfloat *xyz = &(vertices[0].x);
+    BoundingBox box = VertexOps::Bounds(xyz, nvertices);
+    
+    /* Move the center of the bounding box to the origin. The box moves too,
+     * since scaling happens after the translation. */
+    GLfloat offset[3];
+    if(translate) {
+        for(int c = 0; c < 3; ++c) {
+            offset[c] = -((box.max[c] - box.min[c]) * 0.5f + box.min[c]) +
+                        key.origin[c];
+            box.min[c] += offset[c];
+            box.max[c] += offset[c];
+        }
+    }
+    
+    /* Scale so the largest side of the box is max_dim long */
+    GLfloat scalefactor = 1.0f;
+    if(scale) {
+        GLfloat maxdiff = box.max[0] - box.min[0];
+        for(int c = 1; c < 3; ++c) {
+            GLfloat diff = box.max[c] - box.min[c];
+            maxdiff = (maxdiff > diff ? maxdiff : diff);
+        }
+        scalefactor = key.max_dim / maxdiff;
+    }
+    
+    VertexOps::Transform(xyz, nvertices, (translate ? offset : NULL),
+                         scalefactor);
+}
+
+/* Moves each 'width' float record of the array to its new index */
+static void renumber(std::vector<GLfloat> &array, size_t width,
+                     const std::vector<GLuint> &remap)
+{
+    if(array.empty()) {
+        return;
+    }
+    std::vector<GLfloat> result(array.size());
+    for(size_t i = 0; i < remap.size(); ++i) {
+        std::copy(array.begin() + i * width, array.begin() + (i + 1) * width,
+                  result.begin() + remap[i] * width);
+    }
+    array.swap(result);
+}
+
+void WavefrontLoader::optimize(Model *model) {
+    size_t nvertices = model->vertices.size() / 3;
+    std::vector<GLuint> &elements = model->elements;
+    if(elements.empty()) {
         return;
     }
     
-    /* Compute the translation required to center around origin */
-    Vector<GLfloat> translation(max.x - min.x, max.y - min.y, max.z - min.z);
-    translation *= 0.5f;
-    translation += Vector<GLfloat>(min.x, min.y, min.z);
-    translation *= -1.0f;
-    /* Get vector to origin point, add it to our calculated translation */
-    /*TODO: Check my math. I think this results in the correct vector */
-    translation += origin.toVector();
+    /* The model is measured as drawn, one material group after another */
+    loadStats.unoptimized = VertexCache::Measure(&(elements[0]),
+                                                 elements.size(), nvertices);
+    for(size_t i = 0; i < model->ranges.size(); ++i) {
+        const ModelRange &range = model->ranges[i];
+        if(range.count > 0) {
+            VertexCache::Optimize(&(elements[range.first]), range.count);
+        }
+    }
     
+    /* Number the vertices in the order the triangles now use them, so the
+     * vertex arrays are read front to back. Anything unused goes last. */
+    const GLuint unset = 0xFFFFFFFFu;
+    std::vector<GLuint> remap(nvertices, unset);
+    GLuint next = 0;
+    for(size_t i = 0; i < elements.size(); ++i) {
+        GLuint &id = remap[elements[i]];
+        if(id == unset) {
+            id = next++;
+        }
+        elements[i] = id;
+    }
     for(size_t i = 0; i < nvertices; ++i) {
-        vertices[i] += translation;
+        if(remap[i] == unset) {
+            remap[i] = next++;
+        }
+    }
+    renumber(model->vertices, 3, remap);
+    renumber(model->normals, 3, remap);
+    renumber(model->texture, 2, remap);
+    loadStats.optimized = VertexCache::Measure(&(elements[0]),
+                                               elements.size(), nvertices);
+    
+    LOADER_LOG(LOG_INFO, "Vertex Cache Statistics:\n");
+    LOADER_LOG(LOG_INFO, "  ACMR: %.3f -> %.3f\n", loadStats.unoptimized.acmr,
+               loadStats.optimized.acmr);
+    LOADER_LOG(LOG_INFO, "  ATVR: %.3f -> %.3f\n", loadStats.unoptimized.atvr,
+               loadStats.optimized.atvr);
+}
+
+/* Objects, groups and material groups go into the Model sorted by name,
+ * which is the order the loader has always given them in */
+namespace {
+template <typename T>
+class NameOrder {
+public:
+    NameOrder(const SymbolTable &symbols, const std::vector<T> &entries) :
+        symbols(symbols), entries(entries)
+    { }
+    
+    bool operator()(size_t a, size_t b) const {
+        return symbols.name(entries[a].name) < symbols.name(entries[b].name);
     }
-    max.x += translation.vx;
-    max.y += translation.vy;
-    max.z += translation.vz;
-    min.x += translation.vx;
-    min.y += translation.vy;
-    min.z += translation.vz;
+private:
+    const SymbolTable &symbols;
+    const std::vector<T> &entries;
+};
 }
 
-typedef std::map<std::string, LoaderObject>::const_iterator lo_iter;
-typedef std::map<std::string, LoaderGroup>::const_iterator lg_iter;
-typedef std::map<std::string, LoaderMatGroup>::const_iterator lmg_iter;
 Model * WavefrontLoader::cache_to_model() {
-    size_t nobjects = 0, ngroups = 0, nelements = 0;
     Model * model = new Model();
     
     /* Copy model materials over to the newly created model */
     model->materials = materials;
     
-    GLuint current_element = 0, elementid;
-    /* Our map to map distinct elements, allows us to not put redundant
+    /* Count the triangles first so the element index and model arrays can
+     * be sized up front. */
+    size_t ntriangles = 0;
+    for(size_t i = 0; i < matGroups.size(); ++i) {
+        ntriangles += matGroups[i].faces.size();
+    }
+    
+    std::vector<size_t> order(objects.size());
+    for(size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              NameOrder<LoaderObject>(symbols, objects));
+    for(size_t i = 0; i < objects.size(); ++i) {
+        std::vector<size_t> &lgroups = objects[i].groups;
+        std::sort(lgroups.begin(), lgroups.end(),
+                  NameOrder<LoaderGroup>(symbols, groups));
+    }
+    for(size_t i = 0; i < groups.size(); ++i) {
+        std::vector<size_t> &lmgroups = groups[i].material_groups;
+        std::sort(lmgroups.begin(), lmgroups.end(),
+                  NameOrder<LoaderMatGroup>(symbols, matGroups));
+    }
+    /* The Model takes over the names; the symbols stay the same */
+    model->symbols.swap(symbols);
+    
+    /* Each corner is a candidate element, but there can't be many more
+     * distinct elements than there are vertices, normals and texture
+     * coordinates combined. The index grows if this guess is too small. */
+    size_t ncorners = ntriangles * 3;
+    size_t expected = vertices.size() + texCoords.size() + normals.size();
+    expected = (ncorners < expected ? ncorners : expected);
+    
+    /* Our index of distinct elements, allows us to not put redundant
      * elements in our model arrays. */
-    std::map<Element, GLuint> elements;
+    ElementIndex elements(expected);
+    model->vertices.reserve(expected * 3);
+    if(!invalidate_normals) {
+        model->normals.reserve(expected * 3);
+    }
+    if(!invalidate_texcoords) {
+        model->texture.reserve(expected * 2);
+    }
     
     /* Copy elements, ensuring that each element triple corresponds to a single
      * index in the model. This is...annoying to do. */
-    lo_iter lobj_iter, lobj_end;
-    lg_iter lgroup_iter, lgroup_end;
-    lmg_iter lmgroup_iter, lmgroup_end;
-    std::map<Element, GLuint>::iterator element_iter;
-    
-    for(lobj_iter = objects.begin(); lobj_iter != objects.end(); ++lobj_iter) {
-        nobjects += 1;
+    model->elements.reserve(ncorners);
+    GLuint current_element = 0, elementid;
+    bool inserted;
+    for(size_t o = 0; o < order.size(); ++o) {
         /* Get current LoaderObject and create a model object to correspond */
-        const LoaderObject &lobj = lobj_iter->second;
-        Object &object = model->get(lobj_iter->first);
+        const LoaderObject &lobj = objects[order[o]];
+        model->add_object(lobj.name);
         
-        lgroup_end = lobj.groups.end();
-        lgroup_iter = lobj.groups.begin();
-        for(; lgroup_iter != lgroup_end; ++lgroup_iter) {
-            ngroups += 1;
+        for(size_t g = 0; g < lobj.groups.size(); ++g) {
             /* Get current LoaderGroup and create model group to correspond */
-            const LoaderGroup &lgroup = lgroup_iter->second;
-            Group &group = object.get(lgroup_iter->first);
+            const LoaderGroup &lgroup = groups[lobj.groups[g]];
+            model->add_group(lgroup.name);
             
-            lmgroup_end = lgroup.material_groups.end();
-            lmgroup_iter = lgroup.material_groups.begin();
-            for(; lmgroup_iter != lmgroup_end; ++lmgroup_iter) {
-                /* Get current Material Group, create Model Material Group */
-                const LoaderMatGroup &lmgroup = lmgroup_iter->second;
-                MaterialGroup &mgroup = group.get(lmgroup.mtlname);
+            for(size_t m = 0; m < lgroup.material_groups.size(); ++m) {
+                /* Each material group's elements go on the end of the
+                 * model's, and become its range */
+                const LoaderMatGroup &lmgroup =
+                    matGroups[lgroup.material_groups[m]];
+                GLuint first = GLuint(model->elements.size());
                 
                 size_t ntri = lmgroup.faces.size();
-                nelements += ntri;
                 for(size_t i = 0; i < ntri; ++i) {
                     Triangle tri = lmgroup.faces[i];
                     /* Do the delayed invalidation requested by resolve() */
@@ -448,66 +1069,51 @@ Model * WavefrontLoader::cache_to_model() {
                         tri.v3.vn = -1;
                     }
                     
-                    element_iter = elements.find(tri.v1);
-                    if(element_iter == elements.end()) {
-                        elementid = current_element;
-                        current_element++;
-                        elements[tri.v1] = elementid;
-                        
-                        push_element(tri.v1, model);
-                    }else {
-                        elementid = element_iter->second;
-                    }
-                    mgroup.elements.push_back(elementid);
-                    
-                    element_iter = elements.find(tri.v2);
-                    if(element_iter == elements.end()) {
-                        elementid = current_element;
-                        current_element++;
-                        elements[tri.v2] = elementid;
-                        
-                        push_element(tri.v2, model);
-                    }else {
-                        elementid = element_iter->second;
-                    }
-                    mgroup.elements.push_back(elementid);
-                    
-                    element_iter = elements.find(tri.v3);
-                    if(element_iter == elements.end()) {
-                        elementid = current_element;
-                        current_element++;
-                        elements[tri.v3] = elementid;
-                        
-                        push_element(tri.v3, model);
-                    }else {
-                        elementid = element_iter->second;
+                    const Element *corners[3] = { &tri.v1, &tri.v2, &tri.v3 };
+                    for(int c = 0; c < 3; ++c) {
+                        elementid = elements.insert(*(corners[c]),
+                                                    current_element,
+                                                    inserted);
+                        if(inserted) {
+                            current_element++;
+                            push_element(*(corners[c]), model);
+                        }
+                        model->elements.push_back(elementid);
                     }
-                    mgroup.elements.push_back(elementid);
                 }
+                model->add_range(lmgroup.name, first,
+                                 GLuint(model->elements.size()) - first);
             }
         }
     }
     
-    /* Display model statistics */
-    log("Model Statistics:\n");
-    log("    # Objects: %llu\n", (unsigned long long)nobjects);
-    log("     # Groups: %llu\n", (unsigned long long)ngroups);
-    log("  # Materials: %llu\n",(unsigned long long)(model->materials.size()));
-    log("   # Vertices: %llu\n",
-        (unsigned long long)(model->vertices.size()) / 3);
-    log(" # Tex Coords: %llu\n",
-        (unsigned long long)(model->texture.size()) / 2);
-    log("    # Normals: %llu\n",
-        (unsigned long long)(model->normals.size()) / 3);
-    log("  # Triangles: %llu\n", (unsigned long long)nelements);
+    loadStats.corners = elements.lookups();
+    loadStats.distinct = elements.size();
+    LOADER_LOG(LOG_INFO, "Deduplication Statistics:\n");
+    LOADER_LOG(LOG_INFO, "    # Corners: %llu\n",
+               (unsigned long long)elements.lookups());
+    LOADER_LOG(LOG_INFO, "   # Distinct: %llu\n",
+               (unsigned long long)elements.size());
+    LOADER_LOG(LOG_INFO, "    # Reused: %llu\n",
+               (unsigned long long)(elements.lookups() - elements.size()));
+    LOADER_LOG(LOG_INFO, " Avg. Probes: %.3f\n", (elements.lookups() == 0 ?
+               0.0 : double(elements.probes()) / double(elements.lookups())));
+    LOADER_LOG(LOG_INFO, " Table Slots: %llu\n",
+               (unsigned long long)elements.capacity());
     return model;
 }
 
 /*NOTE: could be renamed to 'reset', as that encompasses it's function better
  */
 void WavefrontLoader::clear() {
-    /* This should clean up each sub-map */
+    symbols.clear();
     objects.clear();
+    groups.clear();
+    matGroups.clear();
+    objectIndex.clear();
+    groupIndex.clear();
+    matGroupIndex.clear();
+    libraries.clear();
     faceStack.clear();
     vertices.clear();
     texCoords.clear();
@@ -515,22 +1121,46 @@ void WavefrontLoader::clear() {
     if(!keepMaterials) {
         materials.clear();
     }
-    current.object = NULL;
-    current.group = NULL;
-    current.mgroup = NULL;
-    
-    mat.valid = false;
-    mat.name = "";
-    max.x = max.y = max.z = -FLT_MAX;
-    min.x = min.y = min.z = FLT_MAX;
+    current.object = _no_entry;
+    current.group = _no_entry;
+    current.mgroup = _no_entry;
     
     next.hasMtl = next.hasGroup = next.hasObject = false;
-    next.mtl = next.group = next.object = "";
+    next.mtl = next.group = next.object = symbols.intern("");
     
     invalidate_texcoords = invalidate_normals = false;
 }
 
-void WavefrontLoader::log(const char *msg, ...) {
+void WavefrontLoader::count(const Model *model) {
+    loadStats.objects = model->objects.size();
+    loadStats.groups = model->groups.size();
+    loadStats.triangles = model->elements.size() / 3;
+    loadStats.materials = model->materials.size();
+    loadStats.vertices = model->vertices.size() / 3;
+    loadStats.normals = model->normals.size() / 3;
+    loadStats.texcoords = model->texture.size() / 2;
+    
+    LOADER_LOG(LOG_INFO, "Model Statistics:\n");
+    LOADER_LOG(LOG_INFO, "    # Objects: %llu\n",
+               (unsigned long long)loadStats.objects);
+    LOADER_LOG(LOG_INFO, "     # Groups: %llu\n",
+               (unsigned long long)loadStats.groups);
+    LOADER_LOG(LOG_INFO, "  # Materials: %llu\n",
+               (unsigned long long)loadStats.materials);
+    LOADER_LOG(LOG_INFO, "   # Vertices: %llu\n",
+               (unsigned long long)loadStats.vertices);
+    LOADER_LOG(LOG_INFO, " # Tex Coords: %llu\n",
+               (unsigned long long)loadStats.texcoords);
+    LOADER_LOG(LOG_INFO, "    # Normals: %llu\n",
+               (unsigned long long)loadStats.normals);
+    LOADER_LOG(LOG_INFO, "  # Triangles: %llu\n",
+               (unsigned long long)loadStats.triangles);
+}
+
+void WavefrontLoader::log(LogLevel level, const char *msg, ...) {
+    if(level > verbosity) {
+        return;
+    }
     va_list vargs;
     
     va_start(vargs, msg);
@@ -567,68 +1197,59 @@ void WavefrontLoader::resolve(Element &e) {
     }
 }
 
-void WavefrontLoader::newObject(const std::string &name) {
-    std::map<std::string, LoaderObject>::iterator iter;
-    
-    iter = objects.find(name);
-    if(iter == objects.end()) {
-        objects[name] = LoaderObject(name);
-        current.object = &(objects[name]);
-    }else {
-        current.object = &(iter->second);
+void WavefrontLoader::newObject(Symbol name) {
+    bool inserted;
+    current.object = objectIndex.insert(0, name, uint32_t(objects.size()),
+                                        inserted);
+    if(inserted) {
+        objects.push_back(LoaderObject(name));
     }
     
     newGroup(next.group);
     next.hasObject = false;
 }
 
-void WavefrontLoader::newGroup(const std::string &name) {
-    std::map<std::string, LoaderGroup>::iterator iter;
-    
-    iter = current.object->groups.find(name);
-    if(iter == current.object->groups.end()) {
-        current.object->groups[name] = LoaderGroup(name);
-        current.group = &(current.object->groups[name]);
-    }else {
-        current.group = &(iter->second);
+void WavefrontLoader::newGroup(Symbol name) {
+    bool inserted;
+    current.group = groupIndex.insert(uint32_t(current.object), name,
+                                      uint32_t(groups.size()), inserted);
+    if(inserted) {
+        groups.push_back(LoaderGroup(name));
+        objects[current.object].groups.push_back(current.group);
     }
     
     newMatGroup(next.mtl);
     next.hasGroup = false;
 }
 
-void WavefrontLoader::newMatGroup(const std::string &name) {
+void WavefrontLoader::newMatGroup(Symbol name) {
     /* Check if the material requested has been loaded
      * Invalid references will still create material groups, they will just
      * use the default material.
      * "" is used to represent the default material, which skips the checks
      * for the material in the material maps.
      */
-    std::map<std::string, Material>::iterator miter;
-    if(std::strcmp(name.c_str(), "") != 0) {
-        miter = materials.find(name);
-        if(miter == materials.end()) {
-            if(globalMaterials && globalMaterialMap != NULL) {
-                miter = (*globalMaterialMap).find(name);
-                if(miter == (*globalMaterialMap).end()) {
-                    log("Invalid material reference: %s\n", name.c_str());
-                }
-            }else {
-                log("Invalid material reference: %s\n", name.c_str());
+    const std::string &mtlname = symbols.name(name);
+    if(!mtlname.empty() && materials.find(mtlname) == materials.end()) {
+        if(globalMaterials && globalMaterialMap != NULL) {
+            if(globalMaterialMap->find(mtlname) == globalMaterialMap->end()) {
+                LOADER_LOG(LOG_WARN, "Invalid material reference: %s\n",
+                           mtlname.c_str());
             }
+        }else {
+            LOADER_LOG(LOG_WARN, "Invalid material reference: %s\n",
+                       mtlname.c_str());
         }
     }
     
-    /* Check if the material group already exists */
-    std::map<std::string, LoaderMatGroup>::iterator iter;
-    iter = current.group->material_groups.find(name);
-    if(iter != current.group->material_groups.end()) {
-        /* Set current material group to existing group */
-        current.mgroup = &(iter->second);
-    }else {
-        /* Create new group, set the pointer to it */
-        current.group->material_groups[name] = LoaderMatGroup(name);
-        current.mgroup = &(current.group->material_groups[name]);
+    /* Use the material group if the group already has one */
+    bool inserted;
+    current.mgroup = matGroupIndex.insert(uint32_t(current.group), name,
+                                          uint32_t(matGroups.size()),
+                                          inserted);
+    if(inserted) {
+        matGroups.push_back(LoaderMatGroup(name));
+        groups[current.group].material_groups.push_back(current.mgroup);
     }
     
     next.hasMtl = false;
@@ -645,7 +1266,8 @@ void WavefrontLoader::push_element(const Element &e, Model *mptr) {
     mptr->vertices.push_back(vertices[e.v].z);
     if(!invalidate_texcoords) {
         if((unsigned long long)e.vt >= texCoords.size()) {
-            log("Invalidating Textures: texture index out of bounds\n");
+            LOADER_LOG(LOG_WARN,
+                       "Invalidating Textures: texture index out of bounds\n");
             invalidate_texcoords = true;
             mptr->texture.clear();
         }else {
@@ -655,7 +1277,8 @@ void WavefrontLoader::push_element(const Element &e, Model *mptr) {
     }
     if(!invalidate_normals) {
         if((unsigned long long)e.vn >= normals.size()) {
-            log("Invalidating Normals: normal index out of bounds\n");
+            LOADER_LOG(LOG_WARN,
+                       "Invalidating Normals: normal index out of bounds\n");
             invalidate_normals = true;
             mptr->normals.clear();
         }else {
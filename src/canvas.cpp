@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdexcept>
 #include <unistd.h>
 
@@ -18,8 +19,12 @@
 #include "vrml.hpp"
 #include "mouse.hpp"
 #include "generic/Geometry.hpp"
+#include "generic/GLState.hpp"
 #include "generic/Model.hpp"
+#include "generic/ModelFuture.hpp"
+#include "generic/Primitives.hpp"
 #include "generic/Shader.hpp"
+#include "generic/StaticGeometry.hpp"
 #include "generic/WavefrontLoader.hpp"
 
 /* The current vrml object */
@@ -42,11 +47,25 @@ GLfloat zoomFactor = 1.0;
 
 double _height = 1.0, _radius = 1.0, _base_tri = 8;
 
+/* The model load started by init(), and the loader running it */
+cs354::WavefrontLoader *_loader = NULL;
+cs354::ModelFuture *_pending = NULL;
+/* Where to write the loader statistics as JSON, if anywhere ("-" is stdout) */
+const char *_stats_file = NULL;
+/* Vertex layout the model is uploaded with */
+cs354::Model::VertexFormat _vertex_format = cs354::Model::FORMAT_FLOAT;
+
 bool load_shaders(const char *basename) {
     std::string vshader = std::string(basename) + std::string(".vs");
     std::string fshader = std::string(basename) + std::string(".fs");
+    /* Linked programs are cached next to the shaders */
+    std::string cache_dir = std::string(basename);
+    size_t last_sep = cache_dir.rfind("/");
+    cache_dir = (last_sep == std::string::npos ? std::string(".") :
+                 std::string(cache_dir, 0, last_sep));
     try {
         shader = new cs354::Shader();
+        shader->useCache(cache_dir);
         printf("Loading vertex shader from '%s'\n", vshader.c_str());
         FILE *fp = fopen(vshader.c_str(), "r");
         if(!fp) {
@@ -81,6 +100,45 @@ bool load_shaders(const char *basename) {
     return true;
 }
 
+/* Adds the objects of a VRML file to the vrml display mode, showing the
+ * first one */
+static void load_vrml(const char *fname) {
+    printf("Loading VRML objects from %s\n", fname);
+    int first = vrml::NumObjects();
+    try {
+        int loaded = vrml::Load(fname);
+        printf("Loaded %d VRML objects\n", loaded);
+    }catch(std::exception &err) {
+        fprintf(stderr, "Could not load VRML objects:\n%s\n", err.what());
+    }
+    if(vrml::NumObjects() > first) {
+        vrml::SetObject(first);
+    }
+}
+
+/* Reads a loader log level, by name or as a number from error (0) to
+ * debug (3). Returns false, leaving 'level' alone, for anything else. */
+static bool parse_log_level(const char *arg, int &level) {
+    static const char *names[] = { "error", "warn", "info", "debug" };
+    const int nnames = int(sizeof(names) / sizeof(names[0]));
+    for(int i = 0; i < nnames; ++i) {
+        if(strcmp(arg, names[i]) == 0) {
+            level = i;
+            return true;
+        }
+    }
+    char *stop;
+    long value = strtol(arg, &stop, 10);
+    if(stop == arg || *stop != '\0' ||
+       value < cs354::WavefrontLoader::LOG_ERROR ||
+       value > cs354::WavefrontLoader::LOG_DEBUG)
+    {
+        return false;
+    }
+    level = int(value);
+    return true;
+}
+
 /*
  * Performs specific initializations for this program (as opposed to
  * glut initialization.
@@ -99,19 +157,50 @@ void init(int argc, char **argv) {
     
     const char *_model = _default_model;
     const char *shader_base = _default_shader_base;
+    const char *vrml_file = NULL;
+    bool use_bison = false;
+    bool use_cache = true;
+    bool optimize = false;
+    int log_level = cs354::WavefrontLoader::LOG_INFO;
     
     int c;
-    while((c = getopt(argc, argv, "m:s:")) != -1) {
+    while((c = getopt(argc, argv, "m:s:w:bnocj:v:")) != -1) {
         switch(c) {
         case 'm':
             _model = optarg;
             break;
+        case 'b':
+            use_bison = true;
+            break;
+        case 'n':
+            use_cache = false;
+            break;
+        case 'o':
+            optimize = true;
+            break;
+        case 'c':
+            _vertex_format = cs354::Model::FORMAT_COMPACT;
+            break;
         case 's':
             shader_base = optarg;
             break;
+        case 'w':
+            vrml_file = optarg;
+            break;
+        case 'j':
+            _stats_file = optarg;
+            break;
+        case 'v':
+            if(!parse_log_level(optarg, log_level)) {
+                fprintf(stderr, "Unknown log level '%s'; use error, warn, "
+                        "info or debug (0 to 3).\n", optarg);
+            }
+            break;
         case '?':
         default:
-            if(optopt == 'm' || optopt == 's') {
+            if(optopt == 'm' || optopt == 's' || optopt == 'w' ||
+               optopt == 'j' || optopt == 'v')
+            {
                 fprintf(stderr, "Option -%c requires an argument.\n", optopt);
             }else if(std::isprint(optopt)) {
                 fprintf(stderr, "Unknown option '-%c'.\n", optopt);
@@ -137,19 +226,92 @@ void init(int argc, char **argv) {
         fputs("Warning: Model already initialized. This shouldn't happen.",
               stderr);
     }else {
-        cs354::WavefrontLoader *loader = new cs354::WavefrontLoader();
+        _loader = new cs354::WavefrontLoader();
+        if(use_bison) {
+            _loader->useParser(cs354::WavefrontLoader::PARSER_BISON);
+        }
+        _loader->useCache(use_cache);
+        _loader->useOptimizer(optimize);
+        _loader->useLogLevel(cs354::WavefrontLoader::LogLevel(log_level));
         printf("Loading model from %s\n", _model);
-        try {
-            model = loader->load(_model, cs354::Vertex(0.0, 0.0, 0.0), 2.0);
-        }catch(std::exception &err) {
-            fprintf(stderr, "Could not load model:\n%s\n", err.what());
-        }catch(...) {
-            fputs("Unknown error", stderr);
+        /* Parse on another thread; the free scene draws the GLUT shapes until
+         * myIdle() picks the model up. */
+        _pending = _loader->loadAsync(_model, cs354::Vertex(0.0, 0.0, 0.0),
+                                      2.0);
+        glutIdleFunc(myIdle);
+    }
+    
+    if(vrml_file != NULL) {
+        load_vrml(vrml_file);
+    }
+    
+    draw_model = true;
+    init_static_geometry();
+}
+
+/* Writes the statistics of the model load, if they were asked for */
+static void write_stats(const cs354::LoaderStats &stats) {
+    if(_stats_file == NULL) {
+        return;
+    }
+    if(strcmp(_stats_file, "-") == 0) {
+        stats.writeJSON(stdout);
+        return;
+    }
+    FILE *fp = fopen(_stats_file, "w");
+    if(!fp) {
+        fprintf(stderr, "Could not open '%s'\n", _stats_file);
+        return;
+    }
+    stats.writeJSON(fp);
+    fclose(fp);
+}
+
+/*
+ * Polls the model load started by init(). Once it has finished the model is
+ * handed to the free scene on this (the render) thread and polling stops.
+ */
+void myIdle(void) {
+    if(_pending == NULL) {
+        glutIdleFunc(NULL);
+        return;
+    }
+    
+    switch(_pending->state()) {
+    case cs354::ModelFuture::LOADING:
+        /* Don't spin; the loader may want this core */
+        usleep(5000);
+        return;
+    case cs354::ModelFuture::READY:
+        model = _pending->take();
+        printf("Model loaded\n");
+        {
+            /* This is the render thread, so the GL context is current */
+            cs354::PhaseTimer timer(_loader->stats(),
+                                    cs354::LoaderStats::UPLOAD);
+            model->upload(_vertex_format);
+        }
+        {
+            const cs354::DrawCounters &counters = model->drawCounters();
+            printf("Drawing %lu material groups with %lu draw calls\n",
+                   (unsigned long)counters.groups,
+                   (unsigned long)counters.draws);
         }
-        delete loader;
+        write_stats(_loader->stats());
+        break;
+    case cs354::ModelFuture::FAILED:
+        fprintf(stderr, "Could not load model:\n%s\n",
+                _pending->error().c_str());
+        draw_model = false;
+        break;
     }
     
-    draw_model = (model != NULL);
+    delete _pending;
+    delete _loader;
+    _pending = NULL;
+    _loader = NULL;
+    glutIdleFunc(NULL);
+    glutPostRedisplay();
 }
 
 /*
@@ -158,7 +320,8 @@ void init(int argc, char **argv) {
  */
 void myDisplay (void) {
     
-    glEnable(GL_DEPTH_TEST);	/* Use the Z - buffer for visibility */
+    /* Use the Z - buffer for visibility */
+    cs354::GLState::Enable(GL_DEPTH_TEST);
     glMatrixMode(GL_MODELVIEW);	/* All matrix operations are for the model */
     
     /* Clear the pixels (aka colors) and the z-buffer */
@@ -306,25 +469,33 @@ void resetCamera( void ) {
     zoomFactor = 1.0;
 }
 
-void performanceTest(void) {
+/* Prints the GL calls GLState issued and filtered per frame, on average */
+static void print_gl_counters(const cs354::GLCounters &counters, int frames) {
+    static const char *kinds[cs354::GLCounters::KINDS] = {
+        "Program", "Buffer", "Texture", "Array", "Capability", "Uniform"
+    };
+    printf("GL calls per frame:      issued   filtered\n");
+    for(int k = 0; k < cs354::GLCounters::KINDS; ++k) {
+        printf("  %-20s %10.1f %10.1f\n", kinds[k],
+               double(counters.issued[k]) / frames,
+               double(counters.filtered[k]) / frames);
+    }
+    printf("  %-20s %10.1f %10.1f\n", "Total",
+           double(counters.totalIssued()) / frames,
+           double(counters.totalFiltered()) / frames);
+}
+
+/*
+ * Rotates the camera all the way around each axis, a degree a frame, and
+ * prints the time taken and the GL calls made.
+ */
+static void performance_pass(const char *name) {
     int start, end;
     int i;
-    int curr_width, curr_height;
-    
-    /* Give a warning if the window has been resized */
-    curr_width = glutGet(GLUT_WINDOW_WIDTH);
-    curr_height = glutGet(GLUT_WINDOW_HEIGHT);
-    
-    if ((curr_width != win_width) || (curr_height != win_height)) {
-        printf("*** Warning ***\n");
-        printf("The window has been resized and results may be inaccurate.\n");
-        printf("First press 'z' to restore the default window size.\n");
-        printf("*** Warning ***\n");
-    }
     
     resetCamera();
     
-    printf("Initiating Performance Test\n");
+    cs354::GLState::ResetCounters();
     start = glutGet(GLUT_ELAPSED_TIME);
     
     /* For every rotation, the display loop will be recalled */
@@ -344,8 +515,42 @@ void performanceTest(void) {
     end = glutGet(GLUT_ELAPSED_TIME);
     
     /* Return the number of milliseconds elapsed */
-    printf("Performance Test completed in %.2f sec\n",
-           (end - start) / 1000.0f);
+    if (name != NULL) {
+        printf("Performance Test (%s) completed in %.2f sec\n", name,
+               (end - start) / 1000.0f);
+    } else {
+        printf("Performance Test completed in %.2f sec\n",
+               (end - start) / 1000.0f);
+    }
+    print_gl_counters(cs354::GLState::Counters(), 3 * 360);
+}
+
+void performanceTest(void) {
+    int curr_width, curr_height;
+    
+    /* Give a warning if the window has been resized */
+    curr_width = glutGet(GLUT_WINDOW_WIDTH);
+    curr_height = glutGet(GLUT_WINDOW_HEIGHT);
+    
+    if ((curr_width != win_width) || (curr_height != win_height)) {
+        printf("*** Warning ***\n");
+        printf("The window has been resized and results may be inaccurate.\n");
+        printf("First press 'z' to restore the default window size.\n");
+        printf("*** Warning ***\n");
+    }
+    
+    printf("Initiating Performance Test\n");
+    if (has_immediate_variant(disp_mode)) {
+        /* Run the mode both ways, and leave it the way it was */
+        bool immediate = draw_immediate;
+        draw_immediate = false;
+        performance_pass("buffered");
+        draw_immediate = true;
+        performance_pass("immediate");
+        draw_immediate = immediate;
+    } else {
+        performance_pass(NULL);
+    }
 }
 
 /* Handle user input */
@@ -448,6 +653,14 @@ void myKeyHandler(unsigned char ch, int x, int y) {
     case 't':
         performanceTest();
         break;
+    case 'g':
+        draw_immediate = !draw_immediate;
+        if(draw_immediate) {
+            printf("Cube, cone and vrml modes: drawing in immediate mode\n");
+        }else {
+            printf("Cube, cone and vrml modes: drawing buffered meshes\n");
+        }
+        break;
     case 'q':
         /* Quit with exit code 0 */
         endCanvas(0);
@@ -471,6 +684,18 @@ int endCanvas(int status) {
     printf("\nQuitting canvas.\n\n");
     fflush(stdout);
     
+    /* A load still running uses the static tables exit() destroys, so it
+     * has to finish first; the future waits for it, parse tasks and all */
+    delete _pending;
+    delete _loader;
+    _pending = NULL;
+    _loader = NULL;
+    
+    /* Quitting is a key press, so the GL context is still current for the
+     * cached meshes to give back their buffers */
+    cs354::Primitives::Release();
+    cs354::StaticGeometry::Release();
+    
     exit(status);
 }
 
@@ -17,8 +17,12 @@
 
 #include "drawing.hpp"
 #include "vrml.hpp"
+#include "generic/GLState.hpp"
+#include "generic/Mesh.hpp"
 #include "generic/Model.hpp"
+#include "generic/Primitives.hpp"
 #include "generic/Shader.hpp"
+#include "generic/StaticGeometry.hpp"
 
 #define PI_2 6.28318530718
 
@@ -31,6 +35,7 @@ int disp_style;
 cs354::Shader *shader = NULL;
 cs354::Model *model = NULL;
 bool draw_model;
+bool draw_immediate = false;
 
 /***********************************************************
  * Begin Cube Data
@@ -157,28 +162,77 @@ GLuint cone_indices[] = {
  * End Cone Data
  ***********************************************************/
 
+/* The cube and cone tables as triangles, drawn when not in immediate mode */
+static cs354::Mesh *_cube_mesh = NULL;
+static cs354::Mesh *_cone_mesh = NULL;
 
-/* Uses glut to draw a cube */
+/*
+ * Registers the cube and cone tables with the static geometry and uploads
+ * them.  Called once, after the window (and so the GL context) is made.
+ */
+void init_static_geometry(void) {
+    _cube_mesh = &(cs354::StaticGeometry::Register("cube", cube_vertices,
+        cube_colors, sizeof(cube_vertices) / (3 * sizeof(GLfloat)),
+        cube_indices, sizeof(cube_indices) / sizeof(GLuint), 4));
+    _cone_mesh = &(cs354::StaticGeometry::Register("cone", cone_vertices,
+        cone_colors, sizeof(cone_vertices) / (3 * sizeof(GLfloat)),
+        cone_indices, sizeof(cone_indices) / sizeof(GLuint), 3));
+    cs354::StaticGeometry::Upload();
+}
+
+/* Whether the display mode has an immediate mode version to compare with */
+bool has_immediate_variant(int mode) {
+    switch(mode) {
+    case DM_CUBE_GLUT:
+    case DM_CUBE_QUAD:
+    case DM_CUBE_QUAD_ARRAYS:
+    case DM_CONE_GLUT:
+    case DM_CONE_TRI:
+    case DM_CONE_TRI_ARRAYS:
+    case DM_CONE_TRI_CALC:
+    case DM_VRML:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+/* Draws glut's cube, from the cached primitive or with glut itself */
 void draw_cube_glut(void) {
     /* Draw the cube using glut */
 
     glColor3f(1.0f, 0.0f, 0.0f);
+    if (draw_immediate) {
+        if (disp_style == DS_SOLID) {
+            glutSolidCube(1.0f);
+        } else if (disp_style == DS_WIRE) {
+            glutWireCube(1.0f);
+        }
+        return;
+    }
+    cs354::Mesh &cube = cs354::Primitives::Cube(1.0f);
     if (disp_style == DS_SOLID) {
-        glutSolidCube(1.0f);
+        cube.drawTriangles();
     } else if (disp_style == DS_WIRE) {
-        glutWireCube(1.0f);
+        cube.drawLines();
     }
 }
 
 /*
  * Draws a cube using the data arrays at the top of this file.
- * Iteratively draws each quad in the cube.
+ * Iteratively draws each quad in the cube in immediate mode, and otherwise
+ * draws the cube's static geometry.
  */
 void draw_cube_quad(void) {
     int num_indices;
     int i;
     int index1, index2, index3, index4;
 
+    if (!draw_immediate) {
+        _cube_mesh->drawTriangles();
+        return;
+    }
     num_indices = sizeof(cube_indices) / sizeof(GLuint);
 
     /*
@@ -213,44 +267,65 @@ void draw_cube_quad(void) {
 
 /*
  * Draws a cube using the data arrays at the top of this file.
- * Uses GL's vertex arrays, index arrays, color arrays, etc.
+ * Uses GL's vertex arrays, index arrays, color arrays, etc. in immediate
+ * mode, and otherwise the cube's static geometry.
  */
 void draw_cube_quad_arrays(void) {
     int num_indices;
 
+    if (!draw_immediate) {
+        _cube_mesh->drawTriangles();
+        return;
+    }
     num_indices = sizeof(cube_indices) / sizeof(GLuint);
     
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_COLOR_ARRAY);
+    cs354::GLState::EnableClientState(GL_VERTEX_ARRAY);
+    cs354::GLState::EnableClientState(GL_COLOR_ARRAY);
     
     glVertexPointer(3, GL_FLOAT, 0, cube_vertices);
     glColorPointer(3, GL_FLOAT, 0, cube_colors);
     glDrawElements(GL_QUADS, num_indices, GL_UNSIGNED_INT, cube_indices);
     
-    glDisableClientState(GL_COLOR_ARRAY);
-    glDisableClientState(GL_VERTEX_ARRAY);
+    cs354::GLState::DisableClientState(GL_COLOR_ARRAY);
+    cs354::GLState::DisableClientState(GL_VERTEX_ARRAY);
 }
 
 /*
- * Uses glut to draw a cone.  Must render in either solid and wire
- * frame modes, based on the value of the variable disp_style.
+ * Draws glut's cone, from the cached primitive or with glut itself.  Must
+ * render in either solid and wire frame modes, based on the value of the
+ * variable disp_style.
  */
 void draw_cone_glut(void) {
     /* ADD YOUR CODE HERE */
     glColor3f(0.0f, 0.0f, 1.0f);
+    if (draw_immediate) {
+        if (disp_style == DS_SOLID) {
+            glutSolidCone(1.0f, 1.0f, 50, 50);
+        } else if (disp_style == DS_WIRE) {
+            glutWireCone(1.0f, 1.0f, 50, 50);
+        }
+        return;
+    }
+    cs354::Mesh &cone = cs354::Primitives::Cone(1.0f, 1.0f, 50, 50);
     if (disp_style == DS_SOLID) {
-        glutSolidCone(1.0f, 1.0f, 50, 50);
+        cone.drawTriangles();
     } else if (disp_style == DS_WIRE) {
-        glutWireCone(1.0f, 1.0f, 50, 50);
+        cone.drawLines();
     }
 }
 
 /*
  * Draws a cone using the data arrays at the top of this file.
- * Iteratively draws each triangle in the cone.
+ * Iteratively draws each triangle in the cone in immediate mode, and
+ * otherwise draws the cone's static geometry.
  */
 void draw_cone_tri(void) {
     int num_indices = sizeof(cone_indices) / sizeof(GLuint);
+    
+    if (!draw_immediate) {
+        _cone_mesh->drawTriangles();
+        return;
+    }
 
     int index1, index2, index3;
     for(int i = 0; i < num_indices; i += 3) {
@@ -271,38 +346,89 @@ void draw_cone_tri(void) {
 
 /*
  * Draws a cone using the data arrays at the top of this file.
- * Uses GL's vertex arrays, index arrays, color arrays, etc.
+ * Uses GL's vertex arrays, index arrays, color arrays, etc. in immediate
+ * mode, and otherwise the cone's static geometry.
  */
 void draw_cone_tri_arrays(void) {
     int num_indices = sizeof(cone_indices) / sizeof(GLuint);
     
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_COLOR_ARRAY);
+    if (!draw_immediate) {
+        _cone_mesh->drawTriangles();
+        return;
+    }
+    cs354::GLState::EnableClientState(GL_VERTEX_ARRAY);
+    cs354::GLState::EnableClientState(GL_COLOR_ARRAY);
     
     glVertexPointer(3, GL_FLOAT, 0, cone_vertices);
     glColorPointer(3, GL_FLOAT, 0, cone_colors);
-    glDrawElements(GL_QUADS, num_indices, GL_UNSIGNED_INT, cone_indices);
+    glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, cone_indices);
     
-    glDisableClientState(GL_COLOR_ARRAY);
-    glDisableClientState(GL_VERTEX_ARRAY);
+    cs354::GLState::DisableClientState(GL_COLOR_ARRAY);
+    cs354::GLState::DisableClientState(GL_VERTEX_ARRAY);
 }
 
+/* The calculated cone, which is only rebuilt when its parameters change */
+struct ConeCache {
+    ConeCache() : height(0.0), radius(0.0), base_tri(0), built(false) { }
+    
+    double height, radius;
+    int base_tri;
+    bool built;
+    cs354::Mesh mesh;
+};
+static ConeCache _cone_cache;
+
 /*
- * Draws a cone using a calculated triangulation of the cone surface.
- *
- * Args
- * ----
- * The HEIGHT and RADIUS of the cone.
- *
- * BASE_TRI refers to the number of triangles used to represent
- * the base of the cone.  Each of these triangles should share a
- * common vertex, namely, the center of the base.
- *
- * The final triangulation of the cone surface should include
- * exactly 2 * BASE_TRI.
+ * Fills the mesh with a cone around the y axis.  Vertex 0 is the center
+ * of the base, vertex 1 the tip, and the rest go around the base.  The
+ * points around the base come from rotating the last one by a fixed angle,
+ * so there is only one cos and sin per cone rather than per triangle.
  */
-void draw_cone_tri_calc(double height, double radius, int base_tri) {
-    /* Set up our rendering mode */
+static void build_cone(cs354::Mesh &mesh, double height, double radius,
+                       int base_tri)
+{
+    mesh.clear();
+    if(base_tri < 1) {
+        return;
+    }
+    size_t count = size_t(base_tri);
+    mesh.vertices.reserve((count + 2) * 3);
+    mesh.triangles.reserve(count * 6);
+    mesh.lines.reserve(count * 6);
+    
+    GLfloat center[3] = { 0.0, 0.0, 0.0 };
+    GLfloat tip[3] = { 0.0, GLfloat(height), 0.0 };
+    mesh.vertices.insert(mesh.vertices.end(), center, center + 3);
+    mesh.vertices.insert(mesh.vertices.end(), tip, tip + 3);
+    
+    double step = 1.0 / double(base_tri) * PI_2;
+    double cos_step = cos(step), sin_step = sin(step);
+    double c = 1.0, s = 0.0;
+    for(size_t i = 0; i < count; ++i) {
+        mesh.vertices.push_back(GLfloat(c * radius));
+        mesh.vertices.push_back(0.0f);
+        mesh.vertices.push_back(GLfloat(s * radius));
+        double next = c * cos_step - s * sin_step;
+        s = s * cos_step + c * sin_step;
+        c = next;
+    }
+    
+    /* The last triangle wraps around to the first point */
+    for(size_t i = 0; i < count; ++i) {
+        GLuint v1 = GLuint(2 + i);
+        GLuint v2 = GLuint(2 + (i + 1) % count);
+        GLuint faces[6] = { 0, v2, v1, 1, v2, v1 };
+        GLuint edges[6] = { 0, v1, v1, v2, v1, 1 };
+        mesh.triangles.insert(mesh.triangles.end(), faces, faces + 6);
+        mesh.lines.insert(mesh.lines.end(), edges, edges + 6);
+    }
+}
+
+/* The calculated cone in immediate mode, with a cos and sin per triangle
+ * every frame */
+static void draw_cone_tri_calc_immediate(double height, double radius,
+                                         int base_tri)
+{
     double rad_frac = 1.0 / double(base_tri) * PI_2;
     double currRad = 0.0;
     GLfloat x1, z1, x2, z2;
@@ -310,7 +436,6 @@ void draw_cone_tri_calc(double height, double radius, int base_tri) {
     x1 = radius; /*< cos(0.0) = 1.0 */
     z1 = 0.0; /*< sin(0.0) = 0.0 */
     
-    glColor3f(0.0, 0.0, 1.0);
     if(disp_style == DS_WIRE) {
         glBegin(GL_LINES); {
             for(int i = 0; i < base_tri; i++) {
@@ -353,6 +478,51 @@ void draw_cone_tri_calc(double height, double radius, int base_tri) {
     }
 }
 
+/*
+ * Draws a cone using a calculated triangulation of the cone surface.
+ *
+ * Args
+ * ----
+ * The HEIGHT and RADIUS of the cone.
+ *
+ * BASE_TRI refers to the number of triangles used to represent
+ * the base of the cone.  Each of these triangles should share a
+ * common vertex, namely, the center of the base.
+ *
+ * The final triangulation of the cone surface should include
+ * exactly 2 * BASE_TRI.
+ *
+ * In immediate mode the cone is calculated every frame, and otherwise it
+ * is drawn from a mesh that's only rebuilt when the arguments change.
+ */
+void draw_cone_tri_calc(double height, double radius, int base_tri) {
+    if(draw_immediate) {
+        glColor3f(0.0, 0.0, 1.0);
+        draw_cone_tri_calc_immediate(height, radius, base_tri);
+        return;
+    }
+    
+    ConeCache &cone = _cone_cache;
+    if(!cone.built || cone.height != height || cone.radius != radius ||
+       cone.base_tri != base_tri)
+    {
+        build_cone(cone.mesh, height, radius, base_tri);
+        cone.mesh.upload();
+        cone.mesh.clear();
+        cone.height = height;
+        cone.radius = radius;
+        cone.base_tri = base_tri;
+        cone.built = true;
+    }
+    
+    glColor3f(0.0, 0.0, 1.0);
+    if(disp_style == DS_WIRE) {
+        cone.mesh.drawLines();
+    }else {
+        cone.mesh.drawTriangles();
+    }
+}
+
 /* Draw the various vrml scenes */
 void draw_vrml(void) {
     /* ADD YOUR CODE HERE */
@@ -363,7 +533,11 @@ void draw_vrml(void) {
     } else if (disp_style == DS_WIRE) {
         mode = GL_LINE_LOOP;
     }
-    vrml::CurrentObject().draw(mode);
+    if (draw_immediate) {
+        vrml::CurrentObject().draw(mode);
+    } else {
+        vrml::CurrentObject().drawBuffered(mode);
+    }
 }
 
 /* Draws a freeform scene */
@@ -384,16 +558,20 @@ cs354::Material _sphere_mat = {
 };
 void draw_free_scene(void) {
     if(shader != NULL) {
+        static const cs354::UniformId light_position =
+            cs354::Shader::Uniform("Light.Position");
+        static const cs354::UniformId light_la =
+            cs354::Shader::Uniform("Light.La");
+        static const cs354::UniformId light_ld =
+            cs354::Shader::Uniform("Light.Ld");
+        static const cs354::UniformId light_ls =
+            cs354::Shader::Uniform("Light.Ls");
+        
         shader->use();
-        GLuint prog = shader->handle();
-        GLint loc = glGetUniformLocation(prog, "Light.Position");
-        glUniform4f(loc, 2.0, 10.0, -2.0, 0.0);
-        loc = glGetUniformLocation(prog, "Light.La");
-        glUniform3f(loc, 1.0, 1.0, 1.0);
-        loc = glGetUniformLocation(prog, "Light.Ld");
-        glUniform3f(loc, 1.0, 1.0, 1.0);
-        loc = glGetUniformLocation(prog, "Light.Ls");
-        glUniform3f(loc, 1.0, 1.0, 1.0);
+        shader->setUniform4f(light_position, 2.0, 10.0, -2.0, 0.0);
+        shader->setUniform3f(light_la, 1.0, 1.0, 1.0);
+        shader->setUniform3f(light_ld, 1.0, 1.0, 1.0);
+        shader->setUniform3f(light_ls, 1.0, 1.0, 1.0);
     }
     
     if(model != NULL && draw_model) {
@@ -404,7 +582,7 @@ void draw_free_scene(void) {
         }else {
             glColor3f(0.5, 0.0, 0.0);
         }
-        glutSolidTorus(0.1, 0.4, 100, 40);
+        cs354::Primitives::Torus(0.1f, 0.4f, 100, 40).drawTriangles();
         
         glPushMatrix();
         glTranslatef(1.0f, 0.0f, 1.0f);
@@ -413,7 +591,7 @@ void draw_free_scene(void) {
         }else {
             glColor3f(0.0f, 0.5f, 0.0f);
         }
-        glutSolidSphere(1.0f, 100, 100);
+        cs354::Primitives::Sphere(1.0f, 100, 100).drawTriangles();
         glPopMatrix();
     }
     if(shader) {
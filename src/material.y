@@ -3,23 +3,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
-#include "generic/WavefrontLoader.hpp"
+#include "generic/MaterialLibrary.hpp"
 #include "common.hpp"
 #define YYERROR_VERBOSE 1
-    int mat_lex(void);
-    void mat_error(const char *);
-    extern char *mat_text;
-    extern int mat_leng;
     void mat_unsupported(const char *msg, ...);
-    extern int mat_lineno;
     using namespace cs354;
 }
 
 %code requires {
-#include "generic/WavefrontLoader.hpp"
+#include "generic/MaterialLibrary.hpp"
 #include "common.hpp"
 }
 
+%code {
+    /* Provided by the re-entrant flex scanner */
+    int mat_lex(YYSTYPE *lvalp, void *scanner);
+    int mat_get_lineno(void *scanner);
+    char * mat_get_text(void *scanner);
+    void mat_error(void *scanner, cs354::MaterialLibrary *library,
+                   const char *str);
+}
+
 %union {
     GLfloat float_triplet[3];
     GLfloat fval;
@@ -28,10 +32,16 @@
 }
 
 %defines
+%define api.pure
+%lex-param {void *scanner}
+%parse-param {void *scanner}
+%parse-param {cs354::MaterialLibrary *library}
 %token NEWMTL ILLUM
 %token KA KD KS KE TR NS NI TF
 %token MAP_KA MAP_KD MAP_KS MAP_TR MAP_BUMP MAP_DECAL
-%token TYPE_FLOAT TYPE_INT TYPE_STRING
+%token <fval> TYPE_FLOAT
+%token <ival> TYPE_INT
+%token <str> TYPE_STRING
 %type <float_triplet> float_triple
 %type <fval> floatval floatv
 %type <ival> intv
@@ -49,11 +59,11 @@ exp:
 ;
 
 statement:
-  KA float_triple  { cs354::loader->ka($2); }
-| KD float_triple  { cs354::loader->kd($2); }
-| KS float_triple  { cs354::loader->ks($2); }
+  KA float_triple  { library->ka($2); }
+| KD float_triple  { library->kd($2); }
+| KS float_triple  { library->ks($2); }
 | KE float_triple  { mat_unsupported("ke %f %f %f", $2[0], $2[1], $2[2]); }
-| NS floatval      { cs354::loader->ns($2); }
+| NS floatval      { library->ns($2); }
 | TR floatval      { mat_unsupported("tr %f", $2); }
 | MAP_KA strval    { mat_unsupported("map_ka %s", $2); }
 | MAP_KD strval    { mat_unsupported("map_kd %s", $2); }
@@ -61,7 +71,7 @@ statement:
 | MAP_TR strval    { mat_unsupported("map_tr %s", $2); }
 | MAP_BUMP strval  { mat_unsupported("map_bump %s", $2); }
 | MAP_DECAL strval { mat_unsupported("map_decal %s", $2); }
-| NEWMTL strval    { cs354::loader->newmtl($2); }
+| NEWMTL strval    { library->newmtl($2); }
 | ILLUM intv       { mat_unsupported("illum %d", $2); }
 ;
 
@@ -77,22 +87,24 @@ floatval:
 ;
 
 floatv:
-TYPE_FLOAT { $$ = strtod(mat_text, NULL); }
+TYPE_FLOAT { $$ = $1; }
 ;
 
 intv: 
-TYPE_INT { $$ = strtoll(mat_text, NULL, 10); }
+TYPE_INT { $$ = $1; }
 ;
 
 strval:
-TYPE_STRING { $$ = mat_text; }
+TYPE_STRING { $$ = $1; }
 ;
 
 %%
 
-void mat_error(const char *str) {
-    fprintf(stderr, "Error near line %d: %s [%s]\n", mat_lineno, str,
-            mat_text);
+void mat_error(void *scanner, cs354::MaterialLibrary *library,
+               const char *str)
+{
+    fprintf(stderr, "Error near line %d: %s [%s]\n", mat_get_lineno(scanner),
+            str, mat_get_text(scanner));
 }
 
 void mat_unsupported(const char *str, ...) {
@@ -11,9 +11,17 @@
 
 #include "common.hpp"
 #include "vrml.hpp"
+#include "generic/VertexOps.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 using namespace vrml;
 
@@ -23,9 +31,30 @@ using namespace vrml;
  */
 Object::Object(const char *name, int nv, GLfloat *vertices, int nf,
                GLint *faces) :
-    name(name), nVertices(nv), nFaces(nf), vertices(vertices), indices(faces)
+    name(name), nVertices(nv), nFaces(nf), vertices(vertices), indices(faces),
+    owned(false), converted(false)
 { }
-Object::~Object() { }
+Object::Object(const cs354::VrmlFaceSet &set) :
+    name(NULL), nVertices(int(set.points.size() / 3)), nFaces(int(set.faces)),
+    vertices(NULL), indices(NULL), owned(true), converted(false)
+{
+    const char *source = (set.name.empty() ? "IndexedFaceSet" :
+                          set.name.c_str());
+    char *copy = new char[strlen(source) + 1];
+    strcpy(copy, source);
+    name = copy;
+    vertices = new GLfloat[set.points.size()];
+    std::copy(set.points.begin(), set.points.end(), vertices);
+    indices = new GLint[set.coordIndex.size()];
+    std::copy(set.coordIndex.begin(), set.coordIndex.end(), indices);
+}
+Object::~Object() {
+    if(owned) {
+        delete[] const_cast<char *>(name);
+        delete[] vertices;
+        delete[] indices;
+    }
+}
 
 void Object::draw(GLenum mode) {
     /* Sanity check */
@@ -47,6 +76,61 @@ void Object::draw(GLenum mode) {
     }
 }
 
+void Object::drawBuffered(GLenum mode) {
+    if(!converted) {
+        triangulate(mesh);
+        mesh.upload();
+        mesh.clear();
+        converted = true;
+    }
+    glColor3f(1.0, 1.0, 0.0);
+    if(mode == GL_LINE_LOOP) {
+        mesh.drawLines();
+    }else {
+        mesh.drawTriangles();
+    }
+}
+
+void Object::triangulate(cs354::Mesh &out) const {
+    typedef std::pair<GLuint, GLuint> Edge;
+    
+    out.clear();
+    out.vertices.assign(vertices, vertices + nVertices * 3);
+    
+    std::vector<Edge> edges;
+    int offset = 0;
+    for(int i = 0; i < nFaces; ++i) {
+        int first = offset;
+        while(indices[offset] != -1) {
+            offset += 1;
+        }
+        int count = offset - first;
+        offset += 1;
+        
+        /* Face (a, b, c, d, ...) becomes (a, b, c), (a, c, d), ... */
+        for(int v = 1; v + 1 < count; ++v) {
+            out.triangles.push_back(GLuint(indices[first]));
+            out.triangles.push_back(GLuint(indices[first + v]));
+            out.triangles.push_back(GLuint(indices[first + v + 1]));
+        }
+        /* The loop around the face, smaller index first so that the face
+         * on the other side of an edge gives the same pair */
+        for(int v = 0; count > 1 && v < count; ++v) {
+            GLuint a = GLuint(indices[first + v]);
+            GLuint b = GLuint(indices[first + (v + 1) % count]);
+            edges.push_back(a < b ? Edge(a, b) : Edge(b, a));
+        }
+    }
+    
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    out.lines.reserve(edges.size() * 2);
+    for(size_t e = 0; e < edges.size(); ++e) {
+        out.lines.push_back(edges[e].first);
+        out.lines.push_back(edges[e].second);
+    }
+}
+
 /***********************************************************
  * Begin VRML Cube Data
  ***********************************************************/
@@ -183,23 +267,24 @@ static Object pyramid("Pyramid", 8, pyramid_vertices, 12, pyramid_indices);
 
 static Object *objarray[] = { &cube, &dodeca, &icosa, &pyramid };
 
-static int nobjects = 4;
+/* The objects above, followed by any that are loaded */
+static std::vector<Object *> objects(objarray, objarray + 4);
 static int currobj = 0;
 Object & vrml::CurrentObject() {
-    return *(objarray[currobj]);
+    return *(objects[currobj]);
 }
 void vrml::NextObject() {
-    currobj = (currobj + 1) % nobjects;
+    currobj = (currobj + 1) % NumObjects();
 }
 void vrml::PrevObject() {
     currobj -= 1;
     if(currobj < 0) {
-        currobj = nobjects - 1;
+        currobj = NumObjects() - 1;
     }
 }
 void vrml::SetObject(int num) {
-    if(num >= nobjects) {
-        currobj = nobjects - 1;
+    if(num >= NumObjects()) {
+        currobj = NumObjects() - 1;
     }else if(num < 0) {
         currobj = 0;
     }else {
@@ -208,5 +293,38 @@ void vrml::SetObject(int num) {
 }
 
 int vrml::NumObjects() {
-    return nobjects;
+    return int(objects.size());
+}
+
+/* Centers the object on the origin and scales it to fit in the same two
+ * unit cube as the objects above */
+static void fit(Object &object) {
+    size_t count = size_t(object.nVertices);
+    if(count == 0) {
+        return;
+    }
+    cs354::BoundingBox box = cs354::VertexOps::Bounds(object.vertices, count);
+    GLfloat offset[3], size = 0.0f;
+    for(int i = 0; i < 3; ++i) {
+        offset[i] = -(box.min[i] + box.max[i]) / 2.0f;
+        size = std::max(size, box.max[i] - box.min[i]);
+    }
+    cs354::VertexOps::Transform(object.vertices, count, offset,
+                                (size > 0.0f ? 2.0f / size : 1.0f));
+}
+
+int vrml::Load(const char *fname) {
+    cs354::VrmlParser parser;
+    if(!parser.open(fname)) {
+        throw std::runtime_error(std::string("Could not open ") + fname);
+    }
+    /* The face set is reused, so only the objects grow with the file */
+    cs354::VrmlFaceSet set;
+    int loaded = 0;
+    while(parser.next(set)) {
+        objects.push_back(new Object(set));
+        fit(*(objects.back()));
+        loaded += 1;
+    }
+    return loaded;
 }
@@ -5,16 +5,20 @@
 #include "generic/WavefrontLoader.hpp"
 #include "common.hpp"
 #define YYERROR_VERBOSE 1
-    int wf_lex(void);
-    void wf_error(const char *);
-    extern char *wf_text;
-    extern int wf_leng;
 }
 
 %code requires {
 #include "generic/WavefrontLoader.hpp"
 #include "common.hpp"
-    extern int wf_lineno;
+}
+
+%code {
+    /* Provided by the re-entrant flex scanner */
+    int wf_lex(YYSTYPE *lvalp, void *scanner);
+    int wf_get_lineno(void *scanner);
+    char * wf_get_text(void *scanner);
+    void wf_error(void *scanner, cs354::WavefrontLoader *loader,
+                  const char *str);
 }
 
 %union {
@@ -26,6 +30,10 @@
 }
 
 %defines
+%define api.pure
+%lex-param {void *scanner}
+%parse-param {void *scanner}
+%parse-param {cs354::WavefrontLoader *loader}
 %token OBJECT "o"
 %token GROUP "g"
 %token MTLLIB "mtllib"
@@ -36,7 +44,9 @@
 %token ID_F "f"
 %token ID_SEP "/"
 %token ID_S "s"
-%token TYPE_FLOAT TYPE_INT TYPE_STRING
+%token <fval> TYPE_FLOAT
+%token <ival> TYPE_INT
+%token <str> TYPE_STRING
 %type <float_triplet> float_triple
 %type <int_triplet> face_arg
 %type <fval> floatval floatv
@@ -55,21 +65,24 @@ exp:
 ;
 
 statement:
-  "v" float_triple  { cs354::loader->v($2); }
-| "vn" float_triple { cs354::loader->vn($2); }
-| "vt" float_triple { cs354::loader->vt($2); }
-| "f" face_arg_list { cs354::loader->f(); }
-| "o" strval        { cs354::loader->o($2); }
-| "g" strval        { cs354::loader->g($2); }
+  "v" float_triple  { loader->v($2); }
+| "vn" float_triple { loader->vn($2); }
+| "vt" float_triple { loader->vt($2); }
+| "f" face_arg_list {
+    loader->line(wf_get_lineno(scanner));
+    loader->f();
+  }
+| "o" strval        { loader->o($2); }
+| "g" strval        { loader->g($2); }
 | "s" intv          { fprintf(stderr, "Unsupported Function: 's %d'\n", $2); }
 | "s" strval        { fprintf(stderr, "Unsupported Function: 's %s'\n", $2); }
-| "mtllib" strval   { cs354::loader->mtllib($2); }
-| "usemtl" strval   { cs354::loader->usemtl($2); }
+| "mtllib" strval   { loader->mtllib($2); }
+| "usemtl" strval   { loader->usemtl($2); }
 ;
 
 face_arg_list:
-  face_arg               { cs354::loader->fArg($1); }
-| face_arg_list face_arg { cs354::loader->fArg($2); }
+  face_arg               { loader->fArg($1); }
+| face_arg_list face_arg { loader->fArg($2); }
 ;
 
 face_arg:
@@ -91,19 +104,20 @@ floatval:
 ;
 
 floatv:
-TYPE_FLOAT { $$ = strtod(wf_text, NULL); }
+TYPE_FLOAT { $$ = $1; }
 ;
 
 intv: 
-TYPE_INT { $$ = strtoll(wf_text, NULL, 10); }
+TYPE_INT { $$ = $1; }
 ;
 
 strval:
-TYPE_STRING { $$ = wf_text; }
+TYPE_STRING { $$ = $1; }
 ;
 
 %%
 
-void wf_error(const char *str) {
-    fprintf(stderr, "Error near line %d: %s [%s]\n", wf_lineno, str, wf_text);
+void wf_error(void *scanner, cs354::WavefrontLoader *loader, const char *str) {
+    fprintf(stderr, "Error near line %d: %s [%s]\n", wf_get_lineno(scanner),
+            str, wf_get_text(scanner));
 }